@@ -0,0 +1,85 @@
+#include "FrameDelay.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static constexpr double kMarginMs = 1.5;     // slack kept before vblank
+static constexpr double kMissFactor = 1.5;   // present interval that counts as a miss
+static constexpr int kRetuneFrames = 60;
+static constexpr int kHoldFrames = 300;      // ~5 s without growing after a miss
+static constexpr double kRateTolerance = 0.1; // measured vs nominal frame, beyond = not vsync
+
+static_assert(kRetuneFrames == 60, "intervals_ holds one retune window");
+
+void FrameDelay::init(double hz, FrameStats* stats) {
+    nominal_ms_ = frame_ms_ = 1000.0 / hz;
+    stats_ = stats;
+    stage_cost_ = stats_->stage("delay.cost");
+    stage_delay_ = stats_->stage("delay");
+    last_present_ = FrameStats::now_ms();
+    delay_ = 0.0;
+    hold_ = 0;
+    frames_ = 0;
+}
+
+void FrameDelay::set_delay(double ms) {
+    auto_ = ms < 0.0;
+    delay_ = auto_ ? 0.0 : std::min(ms, frame_ms_ - kMarginMs);
+    if (auto_) std::cerr << "[video] frame delay = auto\n";
+    else std::cerr << "[video] frame delay = " << delay_ << " ms\n";
+}
+
+void FrameDelay::wait() {
+    double until = last_present_ + delay_;
+    double now = FrameStats::now_ms();
+    // SDL_Delay has ~1 ms granularity: sleep most of it, spin the rest
+    if (until - now > 1.5) SDL_Delay((Uint32)(until - now - 1.0));
+    while (FrameStats::now_ms() < until) {}
+
+    work_start_ = FrameStats::now_ms();
+}
+
+void FrameDelay::before_present() {
+    stats_->add(stage_cost_, FrameStats::now_ms() - work_start_);
+}
+
+void FrameDelay::presented() {
+    double now = FrameStats::now_ms();
+    double interval = now - last_present_;
+    last_present_ = now;
+    stats_->add(stage_delay_, delay_);
+
+    if (!auto_) return;
+    intervals_[frames_ % kRetuneFrames] = interval;
+
+    if (interval > frame_ms_ * kMissFactor && frames_ > kRetuneFrames) {
+        // missed vblank: give back time right away and stop growing for a while
+        delay_ = std::max(0.0, delay_ - std::max(1.0, frame_ms_ * 0.1));
+        hold_ = kHoldFrames;
+    }
+    else if (hold_ > 0) {
+        --hold_;
+    }
+
+    if (++frames_ % kRetuneFrames == 0) {
+        measure();
+        retune();
+    }
+}
+
+void FrameDelay::measure() {
+    // the median ignores the odd miss; far from the nominal rate it is not vsync
+    std::array<double, kRetuneFrames> sorted = intervals_;
+    std::nth_element(sorted.begin(), sorted.begin() + kRetuneFrames / 2, sorted.end());
+    double median = sorted[kRetuneFrames / 2];
+    if (std::abs(median - nominal_ms_) > nominal_ms_ * kRateTolerance) return;
+    frame_ms_ = median;
+}
+
+void FrameDelay::retune() {
+    double target = frame_ms_ - stats_->p99(stage_cost_) - kMarginMs;
+    target = std::clamp(target, 0.0, frame_ms_ - kMarginMs);
+
+    if (target < delay_) delay_ = target;                          // shrink at once
+    else if (hold_ == 0) delay_ = std::min(target, delay_ + 1.0);  // grow slowly
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include "FrameStats.h"
+
+// "Frame delay" scheduling for a vsync-paced loop: after the swap returns
+// (~vblank) sleep for most of the frame, then poll input, run the core and
+// render just in time for the next vblank. The delay follows a rolling p99 of
+// the frame's CPU cost and backs off for a while after a missed vblank.
+// The frame is the present interval, not the core's frame: init() takes the
+// display rate and the median measured interval refines it (59.94 vs 60 Hz).
+//
+//   wait()           top of the loop, sleeps until last present + delay
+//   before_present() work done, records its cost
+//   presented()      right after the swap; checks the deadline, retunes
+class FrameDelay {
+public:
+    // hz = vblanks per present (display refresh / swap interval)
+    void init(double hz, FrameStats* stats);
+
+    // < 0 = automatic; otherwise a fixed delay in ms
+    void set_delay(double ms);
+
+    void wait();
+    void before_present();
+    void presented();
+
+    double delay_ms() const { return delay_; }
+    double frame_ms() const { return frame_ms_; }
+
+private:
+    void measure(); // frame_ms_ = median present interval, if close to nominal_ms_
+    void retune();
+
+    double frame_ms_ = 16.67;
+    double nominal_ms_ = 16.67; // from init(); measure() stays near it
+    double delay_ = 0.0;
+    bool auto_ = true;
+
+    double last_present_ = 0.0;
+    double work_start_ = 0.0;
+    int hold_ = 0;   // frames to stay put after a miss
+    int frames_ = 0;
+    std::array<double, 60> intervals_{}; // present intervals since the last retune
+
+    FrameStats* stats_ = nullptr;
+    int stage_cost_ = -1;
+    int stage_delay_ = -1;
+};
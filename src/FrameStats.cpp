@@ -0,0 +1,62 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <cstdio>
+
+int FrameStats::stage(const std::string& name) {
+    std::lock_guard<std::mutex> lock(register_mutex_);
+    for (size_t i = 0; i < stages_.size(); ++i) {
+        if (stages_[i].name == name) return static_cast<int>(i);
+    }
+    stages_.push_back(Stage{});
+    stages_.back().name = name;
+    return static_cast<int>(stages_.size() - 1);
+}
+
+void FrameStats::add(int stage, double ms) {
+    if (stage < 0 || stage >= static_cast<int>(stages_.size())) return;
+    Stage& s = stages_[stage];
+    s.samples[s.next] = ms;
+    s.next = (s.next + 1) % kWindow;
+    if (s.count < kWindow) ++s.count;
+    s.total += ms;
+    ++s.calls;
+}
+
+void FrameStats::end_frame() {
+    ++frames_;
+    if (report_interval_ > 0 && frames_ % report_interval_ == 0) report();
+}
+
+double FrameStats::avg(int stage) const {
+    const Stage& s = stages_[stage];
+    if (s.count == 0) return 0.0;
+    double sum = 0.0;
+    for (int i = 0; i < s.count; ++i) sum += s.samples[i];
+    return sum / s.count;
+}
+
+double FrameStats::p99(int stage) const {
+    const Stage& s = stages_[stage];
+    if (s.count == 0) return 0.0;
+    std::array<double, kWindow> sorted;
+    std::copy(s.samples.begin(), s.samples.begin() + s.count, sorted.begin());
+    int k = std::min(s.count - 1, (s.count * 99) / 100);
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.begin() + s.count);
+    return sorted[k];
+}
+
+double FrameStats::peak(int stage) const {
+    const Stage& s = stages_[stage];
+    if (s.count == 0) return 0.0;
+    return *std::max_element(s.samples.begin(), s.samples.begin() + s.count);
+}
+
+void FrameStats::report() const {
+    std::fprintf(stderr, "[stats] frame %llu\n", static_cast<unsigned long long>(frames_));
+    for (size_t i = 0; i < stages_.size(); ++i) {
+        if (stages_[i].count == 0) continue;
+        int id = static_cast<int>(i);
+        std::fprintf(stderr, "[stats]   %-16s avg=%7.3f ms  p99=%7.3f ms  max=%7.3f ms  total=%9.1f ms\n",
+            stages_[i].name.c_str(), avg(id), p99(id), peak(id), stages_[i].total);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Rolling per-stage timings (ms) with a periodic console report.
+// Stages are registered by name once and then addressed by index, so
+// recording a sample inside the frame loop never allocates.
+class FrameStats {
+public:
+    static constexpr int kWindow = 256; // samples kept per stage for avg/p99
+
+    // returns a stable index for the stage, registering it on first use.
+    // Safe to call from the startup threads; add() is frame-loop only.
+    int stage(const std::string& name);
+
+    void add(int stage, double ms);
+
+    // closes the current frame; prints a report every report_interval frames
+    void end_frame();
+
+    // 0 disables the periodic report
+    void set_report_interval(int frames) { report_interval_ = frames; }
+
+    double avg(int stage) const;
+    double p99(int stage) const;
+    double peak(int stage) const;
+    uint64_t frames() const { return frames_; }
+
+    void report() const;
+
+    // SDL performance counter in milliseconds
+    static double now_ms() {
+        return SDL_GetPerformanceCounter() * 1000.0 / SDL_GetPerformanceFrequency();
+    }
+
+private:
+    struct Stage {
+        std::string name;
+        std::array<double, kWindow> samples{};
+        int count = 0; // valid entries in samples
+        int next = 0;  // ring write position
+        double total = 0.0;
+        uint64_t calls = 0;
+    };
+
+    std::vector<Stage> stages_;
+    std::mutex register_mutex_;
+    int report_interval_ = 0;
+    uint64_t frames_ = 0;
+};
@@ -0,0 +1,83 @@
+#include "StartupTimeline.h"
+#include <algorithm>
+#include <cstdio>
+
+static constexpr int kBarWidth = 40;
+static constexpr double kSlackMs = 0.5; // gap still treated as "started right after"
+
+int StartupTimeline::begin(const char* name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Span s;
+    s.name = name;
+    s.thread = std::this_thread::get_id();
+    s.start = FrameStats::now_ms() - t0_;
+    spans_.push_back(std::move(s));
+    return static_cast<int>(spans_.size() - 1);
+}
+
+void StartupTimeline::end(int span) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (span < 0 || span >= static_cast<int>(spans_.size())) return;
+    spans_[span].end = FrameStats::now_ms() - t0_;
+}
+
+void StartupTimeline::report() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (spans_.empty()) return;
+
+    double total = 0.0;
+    for (const Span& s : spans_) total = std::max(total, s.end);
+    if (total <= 0.0) return;
+
+    // threads numbered in order of first appearance, T0 = the one that started first
+    std::vector<std::thread::id> threads;
+    auto thread_index = [&](std::thread::id id) {
+        auto it = std::find(threads.begin(), threads.end(), id);
+        if (it != threads.end()) return static_cast<int>(it - threads.begin());
+        threads.push_back(id);
+        return static_cast<int>(threads.size() - 1);
+    };
+
+    std::vector<int> order(spans_.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<int>(i);
+    std::stable_sort(order.begin(), order.end(),
+        [&](int a, int b) { return spans_[a].start < spans_[b].start; });
+
+    std::fprintf(stderr, "[startup] timeline, ms since start (%.1f ms total)\n", total);
+    for (int i : order) {
+        const Span& s = spans_[i];
+        double end = s.end < 0.0 ? total : s.end;
+        int from = static_cast<int>(s.start / total * kBarWidth);
+        int to = std::max(from + 1, static_cast<int>(end / total * kBarWidth + 0.5));
+        char bar[kBarWidth + 1];
+        for (int x = 0; x < kBarWidth; ++x) bar[x] = (x >= from && x < to) ? '#' : '.';
+        bar[kBarWidth] = '\0';
+        std::fprintf(stderr, "[startup]   T%d %-16s %7.1f %7.1f %7.1f  %s\n",
+            thread_index(s.thread), s.name.c_str(), s.start, end, end - s.start, bar);
+    }
+
+    // critical path, walked back from the last span to finish
+    std::vector<int> path;
+    int cur = -1;
+    for (size_t i = 0; i < spans_.size(); ++i)
+        if (cur < 0 || spans_[i].end > spans_[cur].end) cur = static_cast<int>(i);
+    while (cur >= 0) {
+        path.push_back(cur);
+        int prev = -1;
+        for (size_t i = 0; i < spans_.size(); ++i) {
+            const Span& s = spans_[i];
+            // only spans that started earlier: with the slack two short spans could
+            // otherwise each count as the other's predecessor and the walk never ends
+            if (s.start >= spans_[cur].start || s.end < 0.0 || s.end > spans_[cur].start + kSlackMs) continue;
+            if (prev < 0 || s.end > spans_[prev].end) prev = static_cast<int>(i);
+        }
+        cur = prev;
+    }
+
+    std::string line;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        if (!line.empty()) line += " > ";
+        line += spans_[*it].name;
+    }
+    std::fprintf(stderr, "[startup] critical path: %s\n", line.c_str());
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameStats.h"
+
+// Spans of the startup task graph (window/GL setup, core load, content load,
+// audio open), recorded from whichever thread runs them. report() prints them
+// on a common time axis with one bar per span, and the critical path: walking
+// back from the last span to finish, each step goes to the span that ended
+// last before the current one started.
+class StartupTimeline {
+public:
+    StartupTimeline() : t0_(FrameStats::now_ms()) {}
+
+    int begin(const char* name);
+    void end(int span);
+
+    // begin() on construction, end() on scope exit
+    class Scope {
+    public:
+        Scope(StartupTimeline* timeline, const char* name)
+            : timeline_(timeline), span_(timeline ? timeline->begin(name) : -1) {}
+        ~Scope() { if (timeline_) timeline_->end(span_); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        StartupTimeline* timeline_;
+        int span_;
+    };
+
+    void report();
+
+private:
+    struct Span {
+        std::string name;
+        std::thread::id thread;
+        double start = 0.0; // ms since t0_
+        double end = -1.0;  // < 0 while running
+    };
+
+    double t0_;
+    std::vector<Span> spans_;
+    std::mutex mutex_;
+};
@@ -1,6 +1,7 @@
 #include "AudioSystem.h"
 #include <iostream>
 #include <cmath>
+#include <cstring>
 #include <vector>
 #include <algorithm>
 
@@ -193,6 +194,18 @@ void AudioSystem::push(const int16_t* data, size_t frames, int core_sample_rate)
     SDL_UnlockAudioDevice(dev);
 }
 
+void AudioSystem::pause(bool paused) {
+    if (!dev) return;
+    SDL_PauseAudioDevice(dev, paused ? 1 : 0);
+}
+
+void AudioSystem::flush() {
+    if (!dev) return;
+    SDL_LockAudioDevice(dev);
+    ring_head_ = ring_tail_ = 0;
+    SDL_UnlockAudioDevice(dev);
+}
+
 void AudioSystem::shutdown() {
     if (!dev) return;
     SDL_PauseAudioDevice(dev, 1);
@@ -19,6 +19,12 @@ public:
 
     int sample_rate() const { return sample_rate_; }
 
+    // pausa o callback (emulacao pausada: sem CPU no thread de audio)
+    void pause(bool paused);
+
+    // descarta o que ainda esta no ring (troca de jogo), o dispositivo continua aberto
+    void flush();
+
     // configura ganho (1.0 = unity)
     void set_gain(float g) { gain_ = g; }
 
@@ -0,0 +1,146 @@
+#include "BootSnapshot.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static const char kStateMagic[8] = { 'S', 'Y', 'N', 'C', 'B', 'O', 'O', '1' };
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t h = 1469598103934665603ull) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// FNV-1a over 8-byte words: the content can be hundreds of MB, bytes are too slow
+static uint64_t fnv1a_words(const void* data, size_t size, uint64_t h) {
+    const unsigned char* p = (const unsigned char*)data;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; ++i, p += 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        h ^= w;
+        h *= 1099511628211ull;
+    }
+    return fnv1a(p, size % 8, h);
+}
+
+void BootSnapshot::hash_content(const std::string& rom_path) {
+    if (hasher_.joinable()) hasher_.join();
+    content_path_ = rom_path;
+    content_ok_ = false;
+    hasher_ = std::thread([this] {
+        std::ifstream f(content_path_, std::ios::binary);
+        if (!f) return;
+        uint64_t h = fnv1a(nullptr, 0);
+        std::vector<char> chunk(1 << 20); // multiple of 8, only the last read has a tail
+        while (f) {
+            f.read(chunk.data(), chunk.size());
+            h = fnv1a_words(chunk.data(), (size_t)f.gcount(), h);
+        }
+        content_hash_ = h;
+        content_ok_ = true;
+    });
+}
+
+void BootSnapshot::prepare(const std::string& core_name, const std::string& core_build) {
+    wait();
+    path_.clear();
+    build_ = core_build;
+
+    if (hasher_.joinable()) hasher_.join();
+    if (!content_ok_) {
+        std::cerr << "[core] boot snapshot: cannot read " << content_path_ << "\n";
+        return;
+    }
+
+    uint64_t h = fnv1a(core_name.data(), core_name.size(), content_hash_);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.state", (unsigned long long)h);
+    path_ = dir_ + "/" + name;
+}
+
+bool BootSnapshot::core_keeps_saves(const std::string& save_dir, const std::string& game) {
+    std::error_code ec;
+    for (std::filesystem::recursive_directory_iterator it(save_dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::filesystem::path& p = it->path();
+        if (!it->is_regular_file(ec) || p.stem() != game) continue;
+        if (p.extension() != ".srm" && p.extension() != ".opt") return true;
+    }
+    return false;
+}
+
+bool BootSnapshot::read(size_t state_size, std::vector<uint8_t>& state) {
+    if (path_.empty()) return false;
+    std::ifstream f(path_, std::ios::binary);
+    if (!f) return false;
+
+    char magic[8];
+    uint32_t frames = 0, build_len = 0;
+    uint64_t size = 0;
+    f.read(magic, sizeof(magic));
+    f.read((char*)&frames, sizeof(frames));
+    f.read((char*)&size, sizeof(size));
+    f.read((char*)&build_len, sizeof(build_len));
+    std::string build(f && build_len <= 1024 ? build_len : 0, '\0');
+    f.read(build.data(), build.size());
+
+    bool valid = f && std::memcmp(magic, kStateMagic, sizeof(magic)) == 0 &&
+        frames == (uint32_t)frames_ && size == state_size && build == build_;
+    if (valid) {
+        state.resize(state_size);
+        f.read((char*)state.data(), state_size);
+        valid = (bool)f;
+    }
+    if (!valid) {
+        // another core build, state layout or frame count: capture again
+        f.close();
+        std::error_code ec;
+        std::filesystem::remove(path_, ec);
+        std::cerr << "[core] boot snapshot " << path_ << " is stale, removed\n";
+        return false;
+    }
+    return true;
+}
+
+void BootSnapshot::write(std::vector<uint8_t> state) {
+    if (path_.empty()) return;
+    wait();
+    writer_ = std::thread([this, state = std::move(state)] { store(state); });
+}
+
+void BootSnapshot::wait() {
+    if (writer_.joinable()) writer_.join();
+    if (hasher_.joinable()) hasher_.join();
+}
+
+void BootSnapshot::store(const std::vector<uint8_t>& state) const {
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+
+    // write aside and rename so a crash never leaves a truncated state behind
+    std::string tmp = path_ + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f) {
+            std::cerr << "[core] boot snapshot: cannot write " << tmp << "\n";
+            return;
+        }
+        uint32_t frames = (uint32_t)frames_;
+        uint64_t size = state.size();
+        uint32_t build_len = (uint32_t)build_.size();
+        f.write(kStateMagic, sizeof(kStateMagic));
+        f.write((const char*)&frames, sizeof(frames));
+        f.write((const char*)&size, sizeof(size));
+        f.write((const char*)&build_len, sizeof(build_len));
+        f.write(build_.data(), build_.size());
+        f.write((const char*)state.data(), state.size());
+        if (!f) return;
+    }
+    std::filesystem::rename(tmp, path_, ec);
+    if (!ec) std::cerr << "[core] boot snapshot saved to " << path_ << " (" << state.size() << " bytes)\n";
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Boot snapshot cache: a savestate taken a fixed number of frames after the
+// first boot of a game (past the board's POST / RAM check), restored right
+// after retro_load_game on later launches.
+//
+// Entries live in cache/boot/<key>.state, key = FNV-1a of the content file and
+// the core's library name. The content is hashed on a thread while the core
+// loads the game. The header records the core build (name, version, library
+// size), the frame count and the serialize size; an entry that does not match
+// is removed and captured again. The state carries the save RAM it booted with:
+// the caller puts the current one back after restoring it.
+class BootSnapshot {
+public:
+    ~BootSnapshot() { wait(); }
+
+    // frames to run before the capture; 0 = off
+    void set_frames(int frames) { frames_ = frames < 0 ? 0 : frames; }
+    int frames() const { return frames_; }
+    bool enabled() const { return frames_ > 0; }
+
+    // starts hashing the content on a thread; call it before retro_load_game
+    void hash_content(const std::string& rom_path);
+    // picks the cache entry for the content and core (waits for the hash)
+    void prepare(const std::string& core_name, const std::string& core_build);
+
+    // NVRAM files the core reads and writes itself in save_dir (<game>.*, other than
+    // .srm and .opt). A state would roll them back, and they change on every exit.
+    static bool core_keeps_saves(const std::string& save_dir, const std::string& game);
+
+    // false when there is no entry, or it was made by another build / saves / state size / frame count
+    bool read(size_t state_size, std::vector<uint8_t>& state);
+    // stores the state on a background thread
+    void write(std::vector<uint8_t> state);
+    // waits for a pending write
+    void wait();
+
+private:
+    void store(const std::vector<uint8_t>& state) const;
+
+    std::string dir_ = "cache/boot";
+    std::string path_; // empty until prepare() succeeded
+    std::string build_;
+    int frames_ = 0;
+    std::thread writer_;
+    std::thread hasher_;
+    std::string content_path_;
+    uint64_t content_hash_ = 0;
+    bool content_ok_ = false; // set by hasher_
+};
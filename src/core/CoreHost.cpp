@@ -0,0 +1,727 @@
+#include "CoreHost.h"
+#include "LibretroCore.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#include <ctime>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+extern char** environ;
+#endif
+
+static constexpr uint32_t kMagic = 0x53485953; // "SYHS"
+static constexpr uint32_t kVersion = 3;
+static constexpr size_t kVideoBytes = 1024 * 1024 * 4; // 1024x1024 XRGB8888
+static constexpr size_t kAudioFrames = 16384;          // stereo frames per retro_run
+static constexpr size_t kStateBytes = 16u << 20;
+static constexpr double kLoadTimeoutMs = 30000.0;
+static constexpr double kFrameTimeoutMs = 2000.0; // a retro_run longer than this is a hang
+static constexpr double kSliceMs = 50.0;          // liveness checks while waiting, longest run_frame() wait
+static constexpr int kMaxRestarts = 3;            // without a checkpoint in between
+
+enum : int32_t { kStarting, kReady, kFailed };
+enum : uint32_t { kRun, kSetOption, kQuit };
+enum : int32_t { kNoCheckpoint = -1, kRestoreFailed, kRestored };
+
+// Zero-filled on creation; the atomics are plain lock-free words, valid as zeros.
+struct CoreHost::Shared {
+    uint32_t magic;
+    uint32_t version;
+
+    // frontend, before the host starts
+    uint32_t parent_pid;
+    int32_t boot_frames;
+    char rom[1024];
+    char core[1024];
+    char options[4096]; // key=value lines
+
+    std::atomic<uint32_t> command_seq; // frontend -> host
+    std::atomic<uint32_t> done_seq;    // host -> frontend
+    std::atomic<int32_t> status;
+
+    // host, once the game is loaded
+    double fps;
+    double sample_rate;
+
+    int32_t restored; // host, with the load answer: a launch over a published checkpoint loads it
+
+    // command
+    uint32_t command;
+    uint32_t throttle;
+    uint32_t save_state; // kRun: checkpoint once the frame is answered
+    uint16_t masks[kPorts];
+    int16_t axes[kPorts][kAxes];
+    char option[512];    // kSetOption: key=value
+
+    // answer
+    uint32_t ok;
+    uint32_t slot; // kRun: out[] the frame went to, the other one is the frontend's
+    uint32_t rotation;
+    float aspect;
+    double core_ms; // retro_run alone, the rest of the round trip is transport
+
+    // host, between frames: state[checkpoint_seq % 2] is written, then checkpoint_seq
+    // bumped, so state[(checkpoint_seq - 1) % 2] is always a complete one (0 = none yet)
+    std::atomic<uint32_t> checkpoint_seq;
+    uint32_t checkpoint_failed; // the core cannot serialize
+    uint64_t state_bytes[2];
+
+    struct Output {
+        uint32_t fresh, width, height, pitch, format;
+        uint32_t audio_frames;
+        alignas(64) uint8_t video[kVideoBytes];
+        alignas(64) int16_t audio[kAudioFrames * 2];
+    } out[2];
+    alignas(64) uint8_t state[2][kStateBytes];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared sequence words must be lock-free");
+
+// --- Doorbell ---
+bool CoreHost::Doorbell::open(const std::string& name, std::atomic<uint32_t>* seq) {
+    seq_ = seq;
+#ifdef _WIN32
+    event_ = CreateEventA(nullptr, FALSE, FALSE, name.c_str()); // or the frontend's
+    return event_ != nullptr;
+#else
+    (void)name;
+    return true;
+#endif
+}
+
+void CoreHost::Doorbell::close() {
+#ifdef _WIN32
+    if (event_) CloseHandle(event_);
+    event_ = nullptr;
+#endif
+    seq_ = nullptr;
+}
+
+void CoreHost::Doorbell::ring() {
+    seq_->fetch_add(1, std::memory_order_acq_rel);
+#ifdef _WIN32
+    SetEvent(event_);
+#elif defined(__linux__)
+    // not FUTEX_PRIVATE_FLAG: the waiter is in another process
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(seq_), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+bool CoreHost::Doorbell::wait(uint32_t seen, double timeout_ms) const {
+    double deadline = FrameStats::now_ms() + timeout_ms;
+    while (seq_->load(std::memory_order_acquire) == seen) {
+        double left = deadline - FrameStats::now_ms();
+        if (left <= 0.0) return false;
+#ifdef _WIN32
+        WaitForSingleObject(event_, (DWORD)std::ceil(left));
+#elif defined(__linux__)
+        timespec ts;
+        ts.tv_sec = (time_t)(left / 1000.0);
+        ts.tv_nsec = (long)(std::fmod(left, 1000.0) * 1e6);
+        // returns at once if the word already moved
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(seq_), FUTEX_WAIT, seen, &ts, nullptr, 0);
+#else
+        usleep(100);
+#endif
+    }
+    return true;
+}
+
+// --- Mapping ---
+bool CoreHost::Mapping::create(const std::string& name, size_t size) {
+    close();
+#ifdef _WIN32
+    handle_ = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        (DWORD)((uint64_t)size >> 32), (DWORD)size, name.c_str());
+    if (!handle_) return false;
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        close();
+        return false;
+    }
+    data_ = MapViewOfFile(handle_, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+    fd_ = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd_ < 0) return false;
+    name_ = name;
+    owner_ = true;
+    if (ftruncate(fd_, (off_t)size) != 0) {
+        close();
+        return false;
+    }
+    data_ = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (data_ == MAP_FAILED) data_ = nullptr;
+#endif
+    size_ = size;
+    if (!data_) close();
+    return data_ != nullptr;
+}
+
+bool CoreHost::Mapping::open(const std::string& name, size_t size) {
+    close();
+#ifdef _WIN32
+    handle_ = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+    if (!handle_) return false;
+    data_ = MapViewOfFile(handle_, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+    fd_ = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd_ < 0) return false;
+    data_ = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (data_ == MAP_FAILED) data_ = nullptr;
+#endif
+    name_ = name;
+    owner_ = false;
+    size_ = size;
+    if (!data_) close();
+    return data_ != nullptr;
+}
+
+void CoreHost::Mapping::close() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (handle_) CloseHandle(handle_);
+    handle_ = nullptr;
+#else
+    if (data_) munmap(data_, size_);
+    if (fd_ >= 0) ::close(fd_);
+    if (owner_ && !name_.empty()) shm_unlink(name_.c_str());
+    fd_ = -1;
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    owner_ = false;
+    name_.clear();
+}
+
+// --- Frontend ---
+void CoreHost::set_stats(FrameStats* stats) {
+    stats_ = stats;
+    stage_ipc_ = stats ? stats->stage("host.ipc") : -1;
+}
+
+std::string CoreHost::options_text() const {
+    std::string options;
+    for (const auto& [key, value] : options_) options += key + "=" + value + "\n";
+    return options;
+}
+
+bool CoreHost::set_option(const std::string& key, const std::string& value) {
+    auto found = std::find_if(options_.begin(), options_.end(),
+        [&](const std::pair<std::string, std::string>& o) { return o.first == key; });
+    bool existed = found != options_.end();
+    std::string previous = existed ? found->second : std::string();
+    if (existed) found->second = value;
+    else options_.emplace_back(key, value);
+    auto undo = [&] {
+        auto o = std::find_if(options_.begin(), options_.end(),
+            [&](const std::pair<std::string, std::string>& o) { return o.first == key; });
+        if (existed) o->second = previous;
+        else options_.erase(o);
+    };
+
+    std::string options = options_text();
+    std::string line = key + "=" + value;
+    if (options.size() >= sizeof(Shared::options) || line.size() >= sizeof(Shared::option)) {
+        std::cerr << "[host] options too long, " << key << " not set\n";
+        undo();
+        return false;
+    }
+    if (!shared_) return true; // start() hands the list over
+
+    if (failed_ || respawn_deadline_ > 0.0 || pending_) {
+        std::cerr << "[host] option " << key << " not set, the host is " << (pending_ ? "busy with a frame" : "not running") << "\n";
+        undo();
+        return false;
+    }
+    Shared* s = shared_;
+    std::memcpy(s->option, line.c_str(), line.size() + 1);
+    s->command = kSetOption;
+    if (!call(kFrameTimeoutMs)) {
+        undo();
+        recover();
+        return false;
+    }
+    if (!s->ok) {
+        undo();
+        return false;
+    }
+    // a restarted host reads the list again
+    std::memcpy(s->options, options.c_str(), options.size() + 1);
+    return true;
+}
+
+bool CoreHost::start(const std::string& rom_path, const std::string& core_path) {
+    stop();
+
+    std::string options = options_text();
+    if (rom_path.size() >= sizeof(Shared::rom) || core_path.size() >= sizeof(Shared::core) ||
+        options.size() >= sizeof(Shared::options)) {
+        std::cerr << "[host] content path or options too long\n";
+        return false;
+    }
+
+    static std::atomic<int> counter{ 0 };
+#ifdef _WIN32
+    uint32_t pid = (uint32_t)GetCurrentProcessId();
+    name_ = "Local\\syncade-host-";
+#else
+    uint32_t pid = (uint32_t)getpid();
+    name_ = "/syncade-host-";
+#endif
+    name_ += std::to_string(pid) + "-" + std::to_string(counter++);
+
+    if (!mapping_.create(name_, sizeof(Shared))) {
+        std::cerr << "[host] cannot create shared memory " << name_ << "\n";
+        return false;
+    }
+    shared_ = (Shared*)mapping_.data();
+    shared_->magic = kMagic;
+    shared_->version = kVersion;
+    shared_->parent_pid = pid;
+    shared_->boot_frames = boot_frames_;
+    std::memcpy(shared_->rom, rom_path.c_str(), rom_path.size() + 1);
+    std::memcpy(shared_->core, core_path.c_str(), core_path.size() + 1);
+    std::memcpy(shared_->options, options.c_str(), options.size() + 1);
+
+    if (!command_.open(name_ + "-command", &shared_->command_seq) ||
+        !done_.open(name_ + "-done", &shared_->done_seq)) {
+        std::cerr << "[host] cannot create the host events\n";
+        stop();
+        return false;
+    }
+
+    frame_slot_ = 0;
+    pending_ = false;
+    frames_to_checkpoint_ = checkpoint_interval_;
+    frames_ = checkpoint_asked_ = checkpoint_frame_ = 0;
+    checkpoint_seen_ = 0;
+    restarts_ = 0;
+    failed_ = false;
+    respawn_deadline_ = 0.0;
+    if (!spawn()) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+bool CoreHost::launch() {
+    shared_->status.store(kStarting, std::memory_order_release);
+    done_seen_ = done_.seq();
+    launch_ms_ = FrameStats::now_ms();
+
+#ifdef _WIN32
+    char exe[MAX_PATH];
+    DWORD n = GetModuleFileNameA(nullptr, exe, MAX_PATH);
+    if (n == 0 || n == MAX_PATH) return false;
+    std::string cmd = std::string("\"") + exe + "\" --core-host " + name_;
+    STARTUPINFOA si{};
+    si.cb = sizeof(si);
+    PROCESS_INFORMATION pi{};
+    if (!CreateProcessA(exe, cmd.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &si, &pi)) {
+        std::cerr << "[host] cannot start " << exe << " (error " << GetLastError() << ")\n";
+        return false;
+    }
+    CloseHandle(pi.hThread);
+    process_ = pi.hProcess;
+#else
+    char exe[4096];
+    ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (n <= 0) return false;
+    exe[n] = '\0';
+    char flag[] = "--core-host";
+    char* argv[] = { exe, flag, name_.data(), nullptr };
+    pid_t pid = -1;
+    if (posix_spawn(&pid, exe, nullptr, nullptr, argv, environ) != 0) {
+        std::cerr << "[host] cannot start " << exe << "\n";
+        return false;
+    }
+    pid_ = pid;
+#endif
+    return true;
+}
+
+bool CoreHost::ready() {
+    if (shared_->status.load(std::memory_order_acquire) != kReady) {
+        std::cerr << "[host] the host did not load " << shared_->rom << "\n";
+        kill();
+        return false;
+    }
+    fps_ = shared_->fps;
+    sample_rate_ = shared_->sample_rate;
+    std::cerr << "[host] core running out of process, ready in " << (FrameStats::now_ms() - launch_ms_) << " ms\n";
+    return true;
+}
+
+void CoreHost::check_checkpoint() {
+    Shared* s = shared_;
+    uint32_t seq = s->checkpoint_seq.load(std::memory_order_acquire);
+    if (seq != checkpoint_seen_) {
+        checkpoint_seen_ = seq;
+        checkpoint_frame_ = checkpoint_asked_;
+        restarts_ = 0;
+    }
+    // a core that cannot serialize leaves the countdown below zero: no more tries
+    if (s->checkpoint_failed && frames_to_checkpoint_ >= 0) {
+        std::cerr << "[host] the core cannot save state, a crash restarts the game from boot\n";
+        frames_to_checkpoint_ = -1;
+    }
+}
+
+bool CoreHost::spawn() {
+    if (!launch()) return false;
+    if (!wait_done(kLoadTimeoutMs)) {
+        std::cerr << "[host] the host did not load " << shared_->rom << "\n";
+        kill();
+        return false;
+    }
+    return ready();
+}
+
+bool CoreHost::wait_done(double timeout_ms) {
+    double deadline = FrameStats::now_ms() + timeout_ms;
+    while (!done_.wait(done_seen_, kSliceMs)) {
+        if (!alive() || FrameStats::now_ms() >= deadline) return false;
+    }
+    done_seen_ = done_.seq();
+    return true;
+}
+
+bool CoreHost::alive() {
+#ifdef _WIN32
+    return process_ && WaitForSingleObject(process_, 0) == WAIT_TIMEOUT;
+#else
+    if (pid_ <= 0) return false;
+    int status = 0;
+    if (waitpid(pid_, &status, WNOHANG) != pid_) return true;
+    if (WIFSIGNALED(status))
+        std::cerr << "[host] host process killed by signal " << WTERMSIG(status) << "\n";
+    pid_ = -1; // reaped
+    return false;
+#endif
+}
+
+void CoreHost::kill() {
+#ifdef _WIN32
+    if (!process_) return;
+    TerminateProcess(process_, 1);
+    WaitForSingleObject(process_, INFINITE);
+    CloseHandle(process_);
+    process_ = nullptr;
+#else
+    if (pid_ <= 0) return;
+    ::kill(pid_, SIGKILL);
+    waitpid(pid_, nullptr, 0);
+    pid_ = -1;
+#endif
+}
+
+void CoreHost::stop() {
+    if (!shared_) return;
+    if (pending_) wait_done(kFrameTimeoutMs);
+    pending_ = false;
+    if (alive()) {
+        // the host saves SRAM and options on the way out
+        shared_->command = kQuit;
+        call(kFrameTimeoutMs);
+        double deadline = FrameStats::now_ms() + kFrameTimeoutMs;
+        while (alive() && FrameStats::now_ms() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    kill();
+    command_.close();
+    done_.close();
+    mapping_.close();
+    shared_ = nullptr;
+    respawn_deadline_ = 0.0;
+}
+
+bool CoreHost::run_frame(const uint16_t* masks, const int16_t* axes, unsigned ports, unsigned throttle) {
+    if (!shared_ || failed_) return false;
+    if (respawn_deadline_ > 0.0 && !poll_respawn()) return false;
+
+    Shared* s = shared_;
+    bool late = pending_;
+    if (!pending_) {
+        s->command = kRun;
+        s->throttle = throttle;
+        for (unsigned p = 0; p < kPorts; ++p) {
+            s->masks[p] = p < ports ? masks[p] : 0;
+            for (unsigned a = 0; a < kAxes; ++a) s->axes[p][a] = p < ports ? axes[p * kAxes + a] : 0;
+        }
+        s->save_state = checkpoint_interval_ > 0 && --frames_to_checkpoint_ == 0;
+        if (s->save_state) {
+            frames_to_checkpoint_ = checkpoint_interval_;
+            checkpoint_asked_ = frames_ + 1;
+        }
+        submitted_ms_ = FrameStats::now_ms();
+        pending_ = true;
+        command_.ring();
+    }
+
+    // one slice at most: a hung core costs the frame thread kSliceMs per call until
+    // the timeout, and the caller keeps presenting, pumping events and feeding audio
+    if (!done_.wait(done_seen_, kSliceMs)) {
+        if (!alive() || FrameStats::now_ms() - submitted_ms_ >= kFrameTimeoutMs) recover();
+        return false;
+    }
+    done_seen_ = done_.seq();
+    pending_ = false;
+    if (stats_ && !late) stats_->add(stage_ipc_, FrameStats::now_ms() - submitted_ms_ - s->core_ms);
+
+    frame_slot_ = s->slot & 1;
+    ++frames_;
+    check_checkpoint();
+    return true;
+}
+
+void CoreHost::recover() {
+    std::cerr << "[host] core " << (alive() ? "stopped responding" : "crashed") << ", restarting the host\n";
+    kill();
+    pending_ = false;
+    if (++restarts_ > kMaxRestarts) {
+        std::cerr << "[host] core failed " << kMaxRestarts << " times in a row, giving up\n";
+        failed_ = true;
+        return;
+    }
+    if (!launch()) {
+        failed_ = true;
+        return;
+    }
+    // the new host loads and restores while the frontend keeps presenting the last frame
+    respawn_deadline_ = launch_ms_ + kLoadTimeoutMs;
+}
+
+bool CoreHost::poll_respawn() {
+    if (!done_.wait(done_seen_, 0.0)) {
+        if (alive() && FrameStats::now_ms() < respawn_deadline_) return false;
+        std::cerr << "[host] the host did not load " << shared_->rom << "\n";
+        kill();
+        respawn_deadline_ = 0.0;
+        failed_ = true;
+        return false;
+    }
+    done_seen_ = done_.seq();
+    respawn_deadline_ = 0.0;
+    if (!ready()) {
+        failed_ = true;
+        return false;
+    }
+    switch (shared_->restored) {
+    case kRestored:
+        std::cerr << "[host] checkpoint restored, " << (frames_ - checkpoint_frame_) << " frames lost\n";
+        break;
+    case kRestoreFailed:
+        std::cerr << "[host] checkpoint restore failed, the game restarts from boot\n";
+        break;
+    default:
+        std::cerr << "[host] no checkpoint, the game restarts from boot\n";
+        break;
+    }
+    frames_to_checkpoint_ = frames_to_checkpoint_ < 0 ? -1 : checkpoint_interval_;
+    checkpoint_frame_ = frames_;
+    return true;
+}
+
+CoreHost::Frame CoreHost::frame() const {
+    Frame f;
+    if (!shared_) return f;
+    const Shared::Output& out = shared_->out[frame_slot_];
+    f.data = out.video;
+    f.width = out.width;
+    f.height = out.height;
+    f.pitch = out.pitch;
+    f.format = (retro_pixel_format)out.format;
+    f.fresh = out.fresh != 0;
+    return f;
+}
+
+const int16_t* CoreHost::audio() const {
+    return shared_ ? shared_->out[frame_slot_].audio : nullptr;
+}
+
+size_t CoreHost::audio_frames() const {
+    return shared_ ? shared_->out[frame_slot_].audio_frames : 0;
+}
+
+unsigned CoreHost::rotation() const {
+    return shared_ ? shared_->rotation : 0;
+}
+
+float CoreHost::aspect() const {
+    return shared_ ? shared_->aspect : 0.0f;
+}
+
+// --- Host process ---
+static bool parent_alive(uint32_t pid) {
+#ifdef _WIN32
+    static HANDLE parent = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    return !parent || WaitForSingleObject(parent, 0) == WAIT_TIMEOUT;
+#else
+    return (uint32_t)getppid() == pid;
+#endif
+}
+
+static retro_pixel_format to_retro(IEmulatorCore::PixelFormat format) {
+    switch (format) {
+    case IEmulatorCore::PixelFormat::XRGB1555: return RETRO_PIXEL_FORMAT_0RGB1555;
+    case IEmulatorCore::PixelFormat::XRGB8888: return RETRO_PIXEL_FORMAT_XRGB8888;
+    default:                                   return RETRO_PIXEL_FORMAT_RGB565;
+    }
+}
+
+int CoreHost::serve(const char* name) {
+    Mapping mapping;
+    if (!mapping.open(name, sizeof(Shared))) {
+        std::cerr << "[host] cannot open shared memory " << name << "\n";
+        return 1;
+    }
+    Shared* s = (Shared*)mapping.data();
+    if (s->magic != kMagic || s->version != kVersion) {
+        std::cerr << "[host] shared memory " << name << " is not a host block\n";
+        return 1;
+    }
+    Doorbell command, done;
+    if (!command.open(std::string(name) + "-command", &s->command_seq) ||
+        !done.open(std::string(name) + "-done", &s->done_seq)) {
+        std::cerr << "[host] cannot open the host events\n";
+        return 1;
+    }
+    uint32_t seen = command.seq();
+
+    // no window, GL or audio device here: frames and samples go back through the block
+    LibretroCore core;
+    core.setAudioOutput(false);
+    core.setFrameLeasing(true);
+    core.setBootSnapshot(s->boot_frames);
+    std::string options = s->options;
+    for (size_t at = 0, end; (end = options.find('\n', at)) != std::string::npos; at = end + 1) {
+        std::string line = options.substr(at, end - at);
+        size_t eq = line.find('=');
+        if (eq != std::string::npos) core.setCoreOption(line.substr(0, eq), line.substr(eq + 1));
+    }
+
+    bool loaded = core.load(s->rom, s->core[0] ? s->core : nullptr);
+    // a restart: back to the last checkpoint the previous host published
+    s->restored = kNoCheckpoint;
+    uint32_t published = s->checkpoint_seq.load(std::memory_order_acquire);
+    if (loaded && published) {
+        unsigned last = (published - 1) & 1;
+        s->restored = s->state_bytes[last] <= kStateBytes &&
+            core.loadState(s->state[last], (size_t)s->state_bytes[last]) ? kRestored : kRestoreFailed;
+    }
+    s->fps = core.timing_fps();
+    s->sample_rate = core.audioFrame().sample_rate;
+    s->rotation = core.rotation();
+    s->aspect = core.aspect();
+    s->status.store(loaded ? kReady : kFailed, std::memory_order_release);
+    done.ring();
+    if (!loaded) return 1;
+
+    bool quit = false;
+    bool oversize_logged = false;
+    unsigned slot = s->slot & 1; // the frontend may still present it: a restart writes the other one first
+    while (!quit) {
+        if (!command.wait(seen, 250.0)) {
+            // the frontend died without a kQuit
+            if (!parent_alive(s->parent_pid)) break;
+            continue;
+        }
+        seen = command.seq();
+
+        bool checkpoint = false;
+        switch (s->command) {
+        case kRun: {
+            for (unsigned p = 0; p < kPorts; ++p) {
+                core.setInputMask(p, s->masks[p]);
+                core.setInputAxes(p, s->axes[p]);
+            }
+            core.setThrottle(s->throttle);
+            double t0 = FrameStats::now_ms();
+            core.runFrame();
+            s->core_ms = FrameStats::now_ms() - t0;
+
+            // one copy per frame into the ring slot the frontend is not reading, rows packed
+            slot ^= 1;
+            Shared::Output& out = s->out[slot];
+            IEmulatorCore::FrameLease lease = core.leaseFrame();
+            out.fresh = 0;
+            if (lease.fresh && lease.data) {
+                size_t row = (size_t)lease.width * (lease.format == IEmulatorCore::PixelFormat::XRGB8888 ? 4 : 2);
+                if (row * lease.height <= kVideoBytes) {
+                    const uint8_t* src = (const uint8_t*)lease.data;
+                    if (row == lease.pitch) {
+                        std::memcpy(out.video, src, row * lease.height);
+                    } else {
+                        for (unsigned y = 0; y < lease.height; ++y)
+                            std::memcpy(out.video + y * row, src + y * lease.pitch, row);
+                    }
+                    out.width = lease.width;
+                    out.height = lease.height;
+                    out.pitch = (uint32_t)row;
+                    out.format = to_retro(lease.format);
+                    out.fresh = 1;
+                } else if (!oversize_logged) {
+                    std::cerr << "[host] frame " << lease.width << "x" << lease.height << " does not fit the block\n";
+                    oversize_logged = true;
+                }
+            }
+
+            IEmulatorCore::AudioView audio = core.audioFrame();
+            size_t frames = (std::min)(audio.frames, kAudioFrames);
+            if (frames) std::memcpy(out.audio, audio.samples, frames * 2 * sizeof(int16_t));
+            out.audio_frames = (uint32_t)frames;
+            s->slot = slot;
+            s->rotation = core.rotation();
+            s->aspect = core.aspect();
+            s->ok = 1;
+            checkpoint = s->save_state != 0;
+            break;
+        }
+        case kSetOption: {
+            // validated and, from here on, saved per game by this LibretroCore
+            std::string line(s->option, strnlen(s->option, sizeof(s->option)));
+            size_t eq = line.find('=');
+            s->ok = eq != std::string::npos && core.setCoreOption(line.substr(0, eq), line.substr(eq + 1));
+            break;
+        }
+        case kQuit:
+            quit = true;
+            break;
+        }
+        done.ring();
+
+        // between frames, the frontend already has this one: into the slot that is
+        // not the last complete checkpoint, published only once it is whole
+        if (checkpoint && !s->checkpoint_failed) {
+            uint32_t seq = s->checkpoint_seq.load(std::memory_order_relaxed);
+            unsigned next = seq & 1;
+            size_t size = core.stateSize();
+            if (size && size <= kStateBytes && core.saveState(s->state[next], size)) {
+                s->state_bytes[next] = size;
+                s->checkpoint_seq.store(seq + 1, std::memory_order_release);
+            } else {
+                s->checkpoint_failed = 1;
+            }
+        }
+    }
+
+    core.unload();
+    return 0;
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <libretro/libretro.h>
+#include "../FrameStats.h"
+
+// Out-of-process core. The libretro core runs in a host process (this same
+// executable started with --core-host <name>) and the frontend drives it one
+// frame at a time through a shared-memory block: input masks and axes go in,
+// the frame's pixels, audio and timing come back in a two-slot ring, so the
+// host never writes the frame being presented. Each side sleeps on a sequence
+// word in the block (futex on Linux, a named event on Windows), nothing is
+// serialized on the frame path.
+//
+// Checkpoints stay off that path too: after answering every checkpoint
+// interval-th frame the host saves state into the free one of two state slots
+// in the block, between frames, and publishes it once complete. The frontend
+// owns the block, so the last complete slot outlives a host that dies.
+//
+// A core that crashes or stops answering only takes the host down. run_frame()
+// waits one liveness slice at most; the watchdog kills a host that is gone or
+// late by the frame timeout and starts a new one, which restores the last
+// checkpoint while it loads in the background. No frames until it is up.
+class CoreHost {
+public:
+    static constexpr unsigned kPorts = 8;
+    static constexpr unsigned kAxes = 6; // per port: LX LY RX RY LT RT
+
+    CoreHost() = default;
+    ~CoreHost() { stop(); }
+    CoreHost(const CoreHost&) = delete;
+    CoreHost& operator=(const CoreHost&) = delete;
+
+    // replaces the key's value. Before start() it is handed to the host's LibretroCore
+    // at launch; while the host runs it is sent to it (and saved per game there).
+    // false = too long, refused by the host's core, or no host to take it.
+    bool set_option(const std::string& key, const std::string& value);
+    void set_boot_snapshot(int frames) { boot_frames_ = frames; }
+    // frames between two checkpoints (default 120); 0 = restart from boot
+    void set_checkpoint_interval(int frames) { checkpoint_interval_ = frames < 0 ? 0 : frames; }
+    // round trip minus the core's own time in "host.ipc"
+    void set_stats(FrameStats* stats);
+
+    // starts the host and waits until it loaded the game
+    bool start(const std::string& rom_path, const std::string& core_path);
+    // asks the host to quit (SRAM and options are saved there), kills it if it does not
+    void stop();
+
+    // one retro_run in the host; axes holds ports * kAxes values. false = no frame:
+    // the host is still busy with the last one (answered by a later call, which
+    // then ignores its own input), restarting, or given up on. The previous frame
+    // and audio are not touched.
+    bool run_frame(const uint16_t* masks, const int16_t* axes, unsigned ports, unsigned throttle);
+
+    // the last frame run_frame() returned, valid until the next one
+    struct Frame {
+        const void* data = nullptr;
+        unsigned width = 0, height = 0;
+        size_t pitch = 0;
+        retro_pixel_format format = RETRO_PIXEL_FORMAT_RGB565;
+        bool fresh = false; // false = the core repeated the previous frame
+    };
+    Frame frame() const;
+    const int16_t* audio() const;
+    size_t audio_frames() const;
+
+    // the loaded game
+    double fps() const { return fps_; }
+    double sample_rate() const { return sample_rate_; }
+    unsigned rotation() const;
+    float aspect() const;
+
+    // host side, called from main(): serves the block until the frontend quits
+    static int serve(const char* name);
+
+private:
+    struct Shared;
+
+    // one direction of the lockstep: a sequence word in the block, bumped by ring()
+    class Doorbell {
+    public:
+        bool open(const std::string& name, std::atomic<uint32_t>* seq);
+        void close();
+        uint32_t seq() const { return seq_->load(std::memory_order_acquire); }
+        void ring();
+        // true once the sequence moved past seen; false after timeout_ms
+        bool wait(uint32_t seen, double timeout_ms) const;
+    private:
+        std::atomic<uint32_t>* seq_ = nullptr;
+#ifdef _WIN32
+        void* event_ = nullptr; // HANDLE, auto-reset; WaitOnAddress stays inside a process
+#endif
+    };
+
+    class Mapping {
+    public:
+        ~Mapping() { close(); }
+        bool create(const std::string& name, size_t size); // frontend
+        bool open(const std::string& name, size_t size);   // host
+        void close();
+        void* data() const { return data_; }
+    private:
+        std::string name_;
+        void* data_ = nullptr;
+        size_t size_ = 0;
+        bool owner_ = false;
+#ifdef _WIN32
+        void* handle_ = nullptr; // HANDLE
+#else
+        int fd_ = -1;
+#endif
+    };
+
+    bool launch();  // starts the host on the current block
+    bool ready();   // the host's load answer is in: fps, sample rate, restored checkpoint
+    bool spawn();   // launch() and wait for the load
+    bool alive();
+    void kill();
+    // waits for the host's answer; false if it died or timed out
+    bool wait_done(double timeout_ms);
+    bool call(double timeout_ms) { command_.ring(); return wait_done(timeout_ms); }
+    void recover(); // watchdog: kill and launch again, the load finishes in poll_respawn()
+    bool poll_respawn(); // true once the restarted host is up and restored
+    void check_checkpoint(); // picks up what the host published since the last frame
+    std::string options_text() const;
+
+    std::string name_;
+    Mapping mapping_;
+    Shared* shared_ = nullptr;
+    Doorbell command_, done_;
+    uint32_t done_seen_ = 0;
+
+    std::vector<std::pair<std::string, std::string>> options_;
+    int boot_frames_ = 0;
+    double fps_ = 60.0;
+    double sample_rate_ = 0.0;
+
+    unsigned frame_slot_ = 0; // out[] slot of the last frame returned
+
+    bool pending_ = false;     // a kRun the host has not answered yet
+    double submitted_ms_ = 0.0;
+
+    int checkpoint_interval_ = 120;
+    int frames_to_checkpoint_ = 0;
+    uint64_t frames_ = 0;            // answered since start()
+    uint64_t checkpoint_asked_ = 0;  // frames_ of the last frame sent with save_state
+    uint64_t checkpoint_frame_ = 0;  // frames_ the published checkpoint was taken at
+    uint32_t checkpoint_seen_ = 0;   // Shared::checkpoint_seq
+    int restarts_ = 0; // since the last checkpoint
+    bool failed_ = false;
+    double launch_ms_ = 0.0;
+    double respawn_deadline_ = 0.0; // > 0 while a restarted host loads; no frames until then
+
+#ifdef _WIN32
+    void* process_ = nullptr; // HANDLE
+#else
+    int pid_ = -1;
+#endif
+
+    FrameStats* stats_ = nullptr;
+    int stage_ipc_ = -1;
+};
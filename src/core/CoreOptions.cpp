@@ -0,0 +1,185 @@
+#include "CoreOptions.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r\n\"");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r\n\"");
+    return s.substr(b, e - b + 1);
+}
+
+const char* CoreOptions::intern(std::string_view s) {
+    return strings_.emplace(s).first->c_str();
+}
+
+bool CoreOptions::load(const std::string& path) {
+    std::ifstream f(path);
+    if (!f) return false;
+
+    std::string line;
+    while (std::getline(f, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string key = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq + 1));
+        file_values_[key] = value;
+        // options already defined take the value now, unless set() chose another
+        if (index_.count(key) && !overrides_.count(key)) apply(key, value);
+    }
+    std::cerr << "[core] options loaded from " << path << " (" << file_values_.size() << " entries)\n";
+    return true;
+}
+
+bool CoreOptions::save(const std::string& path) const {
+    std::error_code ec;
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+
+    std::ofstream f(path, std::ios::trunc);
+    if (!f) {
+        std::cerr << "[core] cannot write options to " << path << "\n";
+        return false;
+    }
+    for (const Option& o : options_) f << o.key << " = \"" << o.value << "\"\n";
+    return true;
+}
+
+void CoreOptions::add(const char* key, const char* desc, const char* default_value,
+    std::vector<const char*> values) {
+    if (!key || values.empty()) return;
+
+    Option opt;
+    opt.key = intern(key);
+    opt.desc = intern(desc ? desc : "");
+    opt.values = std::move(values);
+    opt.value = opt.values.front();
+    if (default_value) {
+        for (const char* v : opt.values)
+            if (std::strcmp(v, default_value) == 0) opt.value = v;
+    }
+    opt.default_value = opt.value;
+
+    auto found = index_.find(opt.key);
+    if (found != index_.end()) {
+        options_[found->second] = std::move(opt); // redefined by the core
+    }
+    else {
+        index_.emplace(opt.key, options_.size());
+        options_.push_back(std::move(opt));
+    }
+
+    // set() value first, then the game's file
+    const std::string* value = nullptr;
+    auto over = overrides_.find(key);
+    if (over != overrides_.end()) value = &over->second;
+    else if (auto file = file_values_.find(key); file != file_values_.end()) value = &file->second;
+    if (value && !apply(key, *value))
+        std::cerr << "[core] option " << key << ": invalid value \"" << *value << "\"\n";
+    updated_ = true;
+}
+
+// "Description; first|second|third", the first value is the default
+void CoreOptions::define_variables(const retro_variable* vars) {
+    for (; vars && vars->key; ++vars) {
+        if (!vars->value) continue;
+        std::string_view spec(vars->value);
+        size_t semi = spec.find("; ");
+        if (semi == std::string_view::npos) continue;
+
+        std::vector<const char*> values;
+        std::string_view list = spec.substr(semi + 2);
+        while (!list.empty()) {
+            size_t bar = list.find('|');
+            values.push_back(intern(list.substr(0, bar)));
+            if (bar == std::string_view::npos) break;
+            list.remove_prefix(bar + 1);
+        }
+        add(vars->key, std::string(spec.substr(0, semi)).c_str(), nullptr, std::move(values));
+    }
+}
+
+void CoreOptions::define(const retro_core_option_definition* defs) {
+    for (; defs && defs->key; ++defs) {
+        std::vector<const char*> values;
+        for (int i = 0; i < RETRO_NUM_CORE_OPTION_VALUES_MAX && defs->values[i].value; ++i)
+            values.push_back(intern(defs->values[i].value));
+        add(defs->key, defs->desc, defs->default_value, std::move(values));
+    }
+}
+
+void CoreOptions::define(const retro_core_option_v2_definition* defs) {
+    for (; defs && defs->key; ++defs) {
+        std::vector<const char*> values;
+        for (int i = 0; i < RETRO_NUM_CORE_OPTION_VALUES_MAX && defs->values[i].value; ++i)
+            values.push_back(intern(defs->values[i].value));
+        add(defs->key, defs->desc, defs->default_value, std::move(values));
+    }
+}
+
+const char* CoreOptions::get(const char* key) const {
+    if (!key) return nullptr;
+    auto found = index_.find(std::string_view(key));
+    return found != index_.end() ? options_[found->second].value : nullptr;
+}
+
+bool CoreOptions::set(const std::string& key, const std::string& value) {
+    // not defined yet: kept for when the core does
+    if (index_.count(key) && !apply(key, value)) return false;
+    overrides_[key] = value;
+    return true;
+}
+
+bool CoreOptions::apply(const std::string& key, const std::string& value) {
+    auto found = index_.find(std::string_view(key));
+    if (found == index_.end()) return false;
+
+    Option& opt = options_[found->second];
+    for (const char* v : opt.values) {
+        if (value == v) {
+            if (opt.value != v) updated_ = true;
+            opt.value = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CoreOptions::warn_undefined() const {
+    for (const auto& [key, value] : overrides_) {
+        if (!index_.count(key))
+            std::cerr << "[core] option " << key << " is not defined by the core, ignored\n";
+    }
+}
+
+bool CoreOptions::take_update() {
+    bool u = updated_;
+    updated_ = false;
+    return u;
+}
+
+void CoreOptions::reset() {
+    for (Option& o : options_) {
+        if (o.value != o.default_value) updated_ = true;
+        o.value = o.default_value;
+    }
+    overrides_.clear();
+    file_values_.clear();
+}
+
+void CoreOptions::clear() {
+    options_.clear();
+    index_.clear();
+    overrides_.clear();
+    file_values_.clear();
+    updated_ = false;
+}
+
+void CoreOptions::log() const {
+    for (const Option& o : options_)
+        std::cerr << "[core]   " << o.key << " = " << o.value << "  (" << o.desc << ")\n";
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <libretro/libretro.h>
+
+// Core option store behind SET_VARIABLES / SET_CORE_OPTIONS(_V2) and
+// GET_VARIABLE / GET_VARIABLE_UPDATE. Every key and value is interned once, so
+// lookups go through a string_view hash map and GET_VARIABLE hands the core a
+// pointer that stays valid for the session without allocating.
+//
+// Per-game values live in a RetroArch-style file (key = "value") that may be
+// loaded before the core defines its options; values are applied on define.
+// Explicit set() values (--option, runtime changes) win over the file's.
+class CoreOptions {
+public:
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    // libretro definitions
+    void define_variables(const retro_variable* vars);
+    void define(const retro_core_option_definition* defs);
+    void define(const retro_core_option_v2_definition* defs);
+
+    // GET_VARIABLE: nullptr if the key is unknown
+    const char* get(const char* key) const;
+    // runtime change; false if the value is not valid for the key. Keys the core has
+    // not defined yet are kept and applied on define. Raises the update flag.
+    bool set(const std::string& key, const std::string& value);
+    // GET_VARIABLE_UPDATE: true once after any change
+    bool take_update();
+
+    // after the game loaded: logs set() keys no definition used (typos, other cores)
+    void warn_undefined() const;
+
+    // next game on the same core: every option back to its default, overrides dropped
+    void reset();
+    // another core: definitions and overrides dropped (interned strings are kept)
+    void clear();
+
+    void log() const;
+
+private:
+    struct Option {
+        const char* key;
+        const char* desc;
+        const char* value;
+        const char* default_value;
+        std::vector<const char*> values;
+    };
+
+    const char* intern(std::string_view s);
+    // value of a defined option; false if the key is unknown or the value invalid
+    bool apply(const std::string& key, const std::string& value);
+    void add(const char* key, const char* desc, const char* default_value,
+        std::vector<const char*> values);
+
+    std::unordered_set<std::string> strings_; // node-based: c_str() stays put
+    std::vector<Option> options_;
+    std::unordered_map<std::string_view, size_t> index_;
+    std::unordered_map<std::string, std::string> overrides_;   // set(), by key
+    std::unordered_map<std::string, std::string> file_values_; // load(), below overrides_
+    bool updated_ = false;
+};
@@ -0,0 +1,131 @@
+#include "CorePerf.h"
+#include <cstdio>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SYNCADE_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+static void cpuid(int leaf, int out[4]) { __cpuid(out, leaf); }
+#else
+#include <cpuid.h>
+static void cpuid(int leaf, int out[4]) { __cpuid_count(leaf, 0, out[0], out[1], out[2], out[3]); }
+#endif
+#endif
+
+CorePerf* CorePerf::s_instance = nullptr;
+
+CorePerf::CorePerf() {
+    s_instance = this;
+    ms_per_tick_ = 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+CorePerf::~CorePerf() {
+    if (s_instance == this) s_instance = nullptr;
+}
+
+void CorePerf::fill(retro_perf_callback* cb) {
+    cb->get_time_usec = get_time_usec;
+    cb->get_cpu_features = get_cpu_features;
+    cb->get_perf_counter = get_perf_counter;
+    cb->perf_register = perf_register;
+    cb->perf_start = perf_start;
+    cb->perf_stop = perf_stop;
+    cb->perf_log = perf_log;
+}
+
+// --- Callbacks ---
+retro_time_t RETRO_CALLCONV CorePerf::get_time_usec() {
+    return (retro_time_t)(SDL_GetPerformanceCounter() * 1000000.0 / SDL_GetPerformanceFrequency());
+}
+
+retro_perf_tick_t RETRO_CALLCONV CorePerf::get_perf_counter() {
+    return SDL_GetPerformanceCounter();
+}
+
+uint64_t RETRO_CALLCONV CorePerf::get_cpu_features() {
+    // SDL also checks OS support (XSAVE) for the AVX family
+    uint64_t f = 0;
+    if (SDL_HasMMX())   f |= RETRO_SIMD_MMX;
+    if (SDL_HasSSE())   f |= RETRO_SIMD_SSE;
+    if (SDL_HasSSE2())  f |= RETRO_SIMD_SSE2;
+    if (SDL_HasSSE3())  f |= RETRO_SIMD_SSE3;
+    if (SDL_HasSSE41()) f |= RETRO_SIMD_SSE4;
+    if (SDL_HasSSE42()) f |= RETRO_SIMD_SSE42;
+    if (SDL_HasAVX())   f |= RETRO_SIMD_AVX;
+    if (SDL_HasAVX2())  f |= RETRO_SIMD_AVX2;
+    if (SDL_HasNEON())  f |= RETRO_SIMD_NEON | RETRO_SIMD_ASIMD;
+
+#ifdef SYNCADE_X86
+    // what SDL does not report
+    int r[4];
+    cpuid(0, r);
+    if (r[0] >= 1) {
+        cpuid(1, r);
+        if (r[3] & (1 << 15)) f |= RETRO_SIMD_CMOV;
+        if (r[2] & (1 << 9))  f |= RETRO_SIMD_SSSE3;
+        if (r[2] & (1 << 22)) f |= RETRO_SIMD_MOVBE;
+        if (r[2] & (1 << 23)) f |= RETRO_SIMD_POPCNT;
+        if (r[2] & (1 << 25)) f |= RETRO_SIMD_AES;
+    }
+    cpuid(0x80000000, r);
+    if ((unsigned)r[0] >= 0x80000001u) {
+        cpuid(0x80000001, r);
+        if (r[3] & (1 << 22)) f |= RETRO_SIMD_MMXEXT;
+    }
+#endif
+    return f;
+}
+
+void RETRO_CALLCONV CorePerf::perf_register(retro_perf_counter* counter) {
+    if (s_instance && counter) s_instance->add(counter);
+}
+
+void RETRO_CALLCONV CorePerf::perf_start(retro_perf_counter* counter) {
+    counter->call_cnt++;
+    counter->start = SDL_GetPerformanceCounter();
+}
+
+void RETRO_CALLCONV CorePerf::perf_stop(retro_perf_counter* counter) {
+    counter->total += SDL_GetPerformanceCounter() - counter->start;
+}
+
+void RETRO_CALLCONV CorePerf::perf_log() {
+    if (s_instance) s_instance->report();
+}
+
+// --- Registry ---
+void CorePerf::add(retro_perf_counter* counter) {
+    if (counter->registered) return;
+    counter->registered = true;
+
+    Counter c{ counter, counter->total, -1 };
+    if (stats_) c.stage = stats_->stage(std::string("perf.") + (counter->ident ? counter->ident : "?"));
+    counters_.push_back(c);
+}
+
+void CorePerf::end_frame() {
+    for (Counter& c : counters_) {
+        retro_perf_tick_t total = c.counter->total;
+        if (stats_) stats_->add(c.stage, (total - c.last_total) * ms_per_tick_);
+        c.last_total = total;
+    }
+}
+
+void CorePerf::report() const {
+    if (counters_.empty()) return;
+    uint64_t frames = stats_ ? stats_->frames() : 0;
+    for (const Counter& c : counters_) {
+        double total_ms = c.counter->total * ms_per_tick_;
+        uint64_t calls = c.counter->call_cnt;
+        std::fprintf(stderr, "[stats]   perf %-24s total=%9.1f ms  calls=%8llu  per-call=%8.4f ms  per-frame=%7.3f ms\n",
+            c.counter->ident ? c.counter->ident : "?", total_ms, (unsigned long long)calls,
+            calls ? total_ms / calls : 0.0, frames ? total_ms / frames : 0.0);
+    }
+}
+
+void CorePerf::clear() {
+    // the library stays loaded in the LRU; back on it, the core registers the
+    // same counters again and they must be taken again
+    for (Counter& c : counters_) c.counter->registered = false;
+    counters_.clear();
+}
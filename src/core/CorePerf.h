@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <libretro/libretro.h>
+#include "../FrameStats.h"
+
+// RETRO_ENVIRONMENT_GET_PERF_INTERFACE. Ticks come from the SDL performance
+// counter (QueryPerformanceCounter / clock_gettime), so they convert to ms.
+// Every registered core counter becomes a FrameStats stage "perf.<ident>"
+// fed with its per-frame delta; report() prints the running totals.
+class CorePerf {
+public:
+    CorePerf();
+    ~CorePerf();
+
+    void fill(retro_perf_callback* cb);
+    void set_stats(FrameStats* stats) { stats_ = stats; }
+
+    // after retro_run: moves each counter's new ticks into its stage
+    void end_frame();
+    void report() const;
+    // counters belong to the core; forget them (and unregister) before it is unloaded
+    void clear();
+
+    static CorePerf* s_instance;
+
+private:
+    struct Counter {
+        retro_perf_counter* counter;
+        retro_perf_tick_t last_total;
+        int stage;
+    };
+
+    static retro_time_t RETRO_CALLCONV get_time_usec();
+    static uint64_t RETRO_CALLCONV get_cpu_features();
+    static retro_perf_tick_t RETRO_CALLCONV get_perf_counter();
+    static void RETRO_CALLCONV perf_register(retro_perf_counter* counter);
+    static void RETRO_CALLCONV perf_start(retro_perf_counter* counter);
+    static void RETRO_CALLCONV perf_stop(retro_perf_counter* counter);
+    static void RETRO_CALLCONV perf_log();
+
+    void add(retro_perf_counter* counter);
+
+    std::vector<Counter> counters_;
+    FrameStats* stats_ = nullptr;
+    double ms_per_tick_ = 0.0;
+};
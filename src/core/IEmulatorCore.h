@@ -1,12 +1,51 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
+// What a frontend (the main loop, headless tools, benchmarks) needs from a core.
+// Everything a frame produces is read back through views instead of callbacks:
+// leaseFrame() and audioFrame() point at memory owned by the core or by the
+// implementation and stay valid until the next runFrame(). Pixels are not
+// copied; audio is gathered from the core's batches into one per-frame buffer.
 class IEmulatorCore {
 public:
+    enum class PixelFormat {
+        XRGB1555,
+        RGB565,
+        XRGB8888,
+        Hardware, // rendered on the GPU, no CPU pixels
+        None,     // no frame yet
+    };
+
+    struct FrameLease {
+        const void* data = nullptr; // nullptr for Hardware / None
+        size_t pitch = 0;           // bytes per row
+        unsigned width = 0;
+        unsigned height = 0;
+        PixelFormat format = PixelFormat::None;
+        bool fresh = false; // produced by the last runFrame(), not a repeat
+    };
+
+    // interleaved stereo int16 from the last runFrame()
+    struct AudioView {
+        const int16_t* samples = nullptr;
+        size_t frames = 0;
+        int sample_rate = 0;
+    };
+
     virtual bool loadROM(const std::string& path) = 0;
     virtual void reset() = 0;
     virtual void runFrame() = 0;
+    // buttons: bit n = RETRO_DEVICE_ID_JOYPAD n; same as setInputMask
     virtual void setInput(int player, int buttons) = 0;
     virtual const void* getVideoBuffer() = 0;
+
+    virtual FrameLease leaseFrame() const = 0;
+    virtual AudioView audioFrame() const = 0;
+    // whole-port button state for the next runFrame(); from then on the port is
+    // driven by the mask instead of the input devices
+    virtual void setInputMask(unsigned port, uint16_t mask) = 0;
+
     virtual ~IEmulatorCore() = default;
 };
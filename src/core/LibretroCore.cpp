@@ -1,28 +1,111 @@
 #include "LibretroCore.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
 
 LibretroCore* LibretroCore::s_instance = nullptr;
 
 // --- Callbacks globais para a Libretro ---
+// not a lambda: GCC cannot turn a variadic lambda into a function pointer
+static void core_log(enum retro_log_level /*level*/, const char* fmt, ...) {
+    va_list args; va_start(args, fmt); vprintf(fmt, args); va_end(args);
+}
+
 static bool core_environment(unsigned cmd, void* data) {
     switch (cmd) {
     case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
-        *(retro_pixel_format*)data = RETRO_PIXEL_FORMAT_RGB565;
-        return true;
+        return LibretroCore::s_instance && data &&
+            LibretroCore::s_instance->set_pixel_format(*(const retro_pixel_format*)data);
+    // GET cases: the core may pass null to probe support, nothing is written then
     case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
+        if (!data) return false;
         *(const char**)data = "roms";
 		return true;
     case RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY:
+        if (!data) return false;
         *(const char**)data = "saves";
         return true;
     case RETRO_ENVIRONMENT_GET_LOG_INTERFACE: {
         auto* cb = (struct retro_log_callback*)data;
-        cb->log = [](enum retro_log_level level, const char* fmt, ...) {
-            va_list args; va_start(args, fmt); vprintf(fmt, args); va_end(args);
-            };
+        if (!cb) return false;
+        cb->log = core_log;
         return true;
     }
+    case RETRO_ENVIRONMENT_SET_HW_RENDER:
+        return LibretroCore::s_instance &&
+            LibretroCore::s_instance->set_hw_render((struct retro_hw_render_callback*)data);
+    case RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER:
+        return LibretroCore::s_instance &&
+            LibretroCore::s_instance->get_software_framebuffer((struct retro_framebuffer*)data);
+    case RETRO_ENVIRONMENT_GET_VARIABLE: {
+        auto* var = (struct retro_variable*)data;
+        if (!var) return false;
+        var->value = LibretroCore::s_instance && var->key ? LibretroCore::s_instance->options().get(var->key) : nullptr;
+        return var->value != nullptr;
+    }
+    case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+        if (!data) return false;
+        *(bool*)data = LibretroCore::s_instance && LibretroCore::s_instance->options().take_update();
+        return true;
+    case RETRO_ENVIRONMENT_SET_VARIABLES:
+        if (LibretroCore::s_instance) LibretroCore::s_instance->options().define_variables((const retro_variable*)data);
+        return true;
+    case RETRO_ENVIRONMENT_GET_CORE_OPTIONS_VERSION:
+        if (!data) return false;
+        *(unsigned*)data = 2;
+        return true;
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS:
+        if (LibretroCore::s_instance) LibretroCore::s_instance->options().define((const retro_core_option_definition*)data);
+        return true;
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS_INTL:
+        if (LibretroCore::s_instance && data)
+            LibretroCore::s_instance->options().define(((const retro_core_options_intl*)data)->us);
+        return true;
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS_V2:
+        if (LibretroCore::s_instance && data)
+            LibretroCore::s_instance->options().define(((const retro_core_options_v2*)data)->definitions);
+        return true;
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS_V2_INTL: {
+        auto* intl = (const retro_core_options_v2_intl*)data;
+        if (LibretroCore::s_instance && intl && intl->us)
+            LibretroCore::s_instance->options().define(intl->us->definitions);
+        return true;
+    }
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY:
+        return true; // sem menu: visibilidade nao importa
+    case RETRO_ENVIRONMENT_GET_PERF_INTERFACE:
+        if (!LibretroCore::s_instance || !data) return false;
+        LibretroCore::s_instance->perf().fill((struct retro_perf_callback*)data);
+        return true;
+    case RETRO_ENVIRONMENT_SET_FRAME_TIME_CALLBACK:
+        return LibretroCore::s_instance &&
+            LibretroCore::s_instance->set_frame_time_callback((const struct retro_frame_time_callback*)data);
+    case RETRO_ENVIRONMENT_GET_THROTTLE_STATE:
+        if (!LibretroCore::s_instance || !data) return false;
+        LibretroCore::s_instance->get_throttle_state((struct retro_throttle_state*)data);
+        return true;
+    case RETRO_ENVIRONMENT_GET_FASTFORWARDING:
+        if (!data) return false;
+        *(bool*)data = LibretroCore::s_instance && LibretroCore::s_instance->fast_forward();
+        return true;
+    case RETRO_ENVIRONMENT_GET_INPUT_BITMASKS:
+        // RETRO_DEVICE_ID_JOYPAD_MASK: all buttons of a port in one input_state call
+        return true;
+    case RETRO_ENVIRONMENT_GET_PREFERRED_HW_RENDER:
+        if (!data) return false;
+        *(unsigned*)data = RETRO_HW_CONTEXT_OPENGL_CORE;
+        return true;
+    case RETRO_ENVIRONMENT_SET_ROTATION:
+        // applied on the GPU by GameRenderPass, the core keeps its native orientation
+        if (LibretroCore::s_instance && data) LibretroCore::s_instance->set_rotation(*(const unsigned*)data);
+        return true;
+    case RETRO_ENVIRONMENT_SET_GEOMETRY:
+        if (LibretroCore::s_instance && data) LibretroCore::s_instance->set_geometry(*(const retro_game_geometry*)data);
+        return true;
     case RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE:
+        if (!data) return false;
         *(int*)data = 1 | 2; // Vdeo e udio ativados
         return true;
     }
@@ -33,6 +116,15 @@ static void core_video_refresh(const void* data, unsigned w, unsigned h, size_t
     if (LibretroCore::s_instance) LibretroCore::s_instance->on_video_frame(data, w, h, pitch);
 }
 
+static uintptr_t RETRO_CALLCONV hw_get_current_framebuffer() {
+    return LibretroCore::s_instance ? LibretroCore::s_instance->hw_framebuffer() : 0;
+}
+
+static retro_proc_address_t RETRO_CALLCONV hw_get_proc_address(const char* sym) {
+    if (!LibretroCore::s_instance || !LibretroCore::s_instance->gl_loader()) return nullptr;
+    return (retro_proc_address_t)LibretroCore::s_instance->gl_loader()(sym);
+}
+
 static void core_audio_sample(int16_t l, int16_t r) {
     if (LibretroCore::s_instance) LibretroCore::s_instance->push_audio_sample(l, r);
 }
@@ -44,17 +136,149 @@ static size_t core_audio_sample_batch(const int16_t* data, size_t frames) {
 
 // --- Implementao da Classe ---
 
-LibretroCore::LibretroCore() { s_instance = this; }
+LibretroCore::LibretroCore() {
+    s_instance = this;
+    stage_core_ = stats_.stage("core");
+    stage_upload_ = stats_.stage("upload");
+    stage_gpu_upload_ = stats_.stage("gpu.upload");
+    stage_present_ = stats_.stage("present");
+    perf_.set_stats(&stats_);
+    sram_.set_stats(&stats_);
+}
 LibretroCore::~LibretroCore() { unload(); }
 
-FARPROC LibretroCore::resolve(const char* name) {
-    return GetProcAddress(core_handle_, name);
+void LibretroCore::setOutOfProcess(bool enabled) {
+    host_.reset();
+    if (!enabled) return;
+    host_ = std::make_unique<CoreHost>();
+    host_->set_stats(&stats_);
+}
+
+void LibretroCore::setContext(GLContext* ctx) {
+    out_fbo_ = ctx->target_framebuffer();
+    out_w_ = ctx->width();
+    out_h_ = ctx->height();
+    gl_loader_ = ctx->loader();
+    window_ = ctx->window();
+    gl_output_ = true;
+}
+
+#ifdef _WIN32
+static const char* kCorePath = "cores/fbneo_libretro.dll";
+
+void* LibretroCore::resolve(const char* name) {
+    return (void*)GetProcAddress(core_handle_, name);
 }
+#else
+static const char* kCorePath = "cores/fbneo_libretro.so";
+
+void* LibretroCore::resolve(const char* name) {
+    return dlsym(core_handle_, name);
+}
+#endif
+
+bool LibretroCore::load(const char* rom_path, const char* core_path) {
+    return begin_load(rom_path, core_path) && finish_load();
+}
+
+bool LibretroCore::begin_load(const char* rom_path, const char* core_path) {
+    if (loader_.joinable()) return false;
+    rom_path_ = rom_path;
+    core_path_ = core_path ? core_path : kCorePath;
+    load_ok_ = false;
+    loader_ = std::thread(&LibretroCore::load_core, this);
+    return true;
+}
+
+// Thread de carga: arquivo de opcoes e a DLL. Nenhuma funcao do core roda aqui:
+// retro_set_environment, retro_init e retro_load_game ficam com finish_load(), na
+// thread que chama retro_run (cores com libco ou thread_local dependem disso).
+void LibretroCore::load_core() {
+    if (host_) {
+        // out of process: the host loads everything, the audio waits for its sample rate
+        {
+            StartupTimeline::Scope span(timeline_, "host.start");
+            host_->set_boot_snapshot(boot_.frames());
+            load_ok_ = host_->start(rom_path_, core_path_);
+        }
+        sample_rate_core_ = static_cast<int>(host_->sample_rate() + 0.5);
+        if (load_ok_ && audio_output_) audio_thread_ = std::thread(&LibretroCore::open_audio, this);
+        return;
+    }
+
+    StartupTimeline::Scope span(timeline_, "core.open");
+    // per-game options, read before the core defines its own
+    set_game(rom_path_);
+    load_ok_ = open_library(core_path_);
+}
+
+bool LibretroCore::init_game() {
+    {
+        StartupTimeline::Scope span(timeline_, "core.init");
+        bind_core();
+        init_core();
+    }
+
+    // the device probing overlaps retro_load_game
+    if (audio_output_) audio_thread_ = std::thread(&LibretroCore::open_audio, this);
+
+    bool ok;
+    {
+        StartupTimeline::Scope span(timeline_, "core.load_game");
+        ok = load_content();
+    }
+    if (audio_thread_.joinable()) audio_thread_.join();
+    return ok;
+}
+
+void LibretroCore::set_game(const std::string& rom_path) {
+    rom_path_ = rom_path;
+    std::string game = rom_path;
+    size_t slash = game.find_last_of("/\\");
+    if (slash != std::string::npos) game.erase(0, slash + 1);
+    size_t dot = game.find_last_of('.');
+    if (dot != std::string::npos) game.erase(dot);
+    options_path_ = "saves/" + game + ".opt";
+    sram_path_ = "saves/" + game + ".srm";
+    options_.load(options_path_);
+    // the boot snapshot key; the hash runs while the core loads the game
+    if (boot_.enabled()) boot_.hash_content(rom_path);
+}
+
+bool LibretroCore::open_library(const std::string& path) {
+    auto cached = std::find_if(cores_.begin(), cores_.end(),
+        [&](const CoreLibrary& lib) { return lib.path == path; });
+    if (cached != cores_.end()) {
+        std::rotate(cores_.begin(), cached, cached + 1);
+    } else {
+#ifdef _WIN32
+        CoreHandle handle = LoadLibraryA(path.c_str());
+#else
+        CoreHandle handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+        if (!handle) {
+            std::cerr << "[core] cannot load " << path << "\n";
+            return false;
+        }
+        cores_.insert(cores_.begin(), CoreLibrary{ path, handle });
 
-bool LibretroCore::load(const char* rom_path) {
-    core_handle_ = LoadLibraryA("cores/fbneo_libretro.dll");
-    if (!core_handle_) return false;
+        // least recently used out; none of these is initialised
+        while (cores_.size() > kMaxCores) {
+#ifdef _WIN32
+            FreeLibrary(cores_.back().handle);
+#else
+            dlclose(cores_.back().handle);
+#endif
+            cores_.pop_back();
+        }
+    }
+
+    core_handle_ = cores_.front().handle;
+    core_path_ = path;
+    return true;
+}
 
+void LibretroCore::bind_core() {
     // Binding das funes
     retro_init_ = (void(*)())resolve("retro_init");
     retro_run_ = (void(*)())resolve("retro_run");
@@ -68,6 +292,13 @@ bool LibretroCore::load(const char* rom_path) {
     retro_get_system_av_info_ = (void(*)(retro_system_av_info*))resolve("retro_get_system_av_info");
     retro_deinit_ = (void(*)())resolve("retro_deinit");
     retro_unload_game_ = (void(*)())resolve("retro_unload_game");
+    retro_reset_ = (void(*)())resolve("retro_reset");
+    retro_get_memory_data_ = (void*(*)(unsigned))resolve("retro_get_memory_data");
+    retro_get_memory_size_ = (size_t(*)(unsigned))resolve("retro_get_memory_size");
+    retro_get_system_info_ = (void(*)(retro_system_info*))resolve("retro_get_system_info");
+    retro_serialize_size_ = (size_t(*)())resolve("retro_serialize_size");
+    retro_serialize_ = (bool(*)(void*, size_t))resolve("retro_serialize");
+    retro_unserialize_ = (bool(*)(const void*, size_t))resolve("retro_unserialize");
 
     // Configurao inicial
     retro_set_environment_(core_environment);
@@ -76,22 +307,57 @@ bool LibretroCore::load(const char* rom_path) {
     retro_set_audio_sample_batch_(core_audio_sample_batch);
     retro_set_input_poll_(input_poll_cb);
     retro_set_input_state_(input_state_cb);
+}
 
+void LibretroCore::init_core() {
     retro_init_();
 
-    // 3. Lgica de Inicializao de udio com Fallbacks
-    int requestedSampleRate = 0;
     if (retro_get_system_av_info_) {
         retro_system_av_info info;
         std::memset(&info, 0, sizeof(info));
         retro_get_system_av_info_(&info);
 
-        requestedSampleRate = static_cast<int>(info.timing.sample_rate + 0.5);
-        this->sample_rate_core_ = requestedSampleRate; // Salva para o push_audio
+        this->sample_rate_core_ = static_cast<int>(info.timing.sample_rate + 0.5); // Salva para o push_audio
         this->fps_ = (int)info.timing.fps;
+        this->timing_fps_ = info.timing.fps;
+    }
+}
 
-        std::cerr << "[audio] core requested sample_rate = " << requestedSampleRate << "\n";
+bool LibretroCore::load_content() {
+    // the core sets these again while it loads the game; a core that never sets
+    // the pixel format gets the libretro default, not the previous core's
+    video_.set_format(RETRO_PIXEL_FORMAT_0RGB1555);
+    if (sdl_video_) sdl_video_->set_format(RETRO_PIXEL_FORMAT_0RGB1555);
+    rotation_ = 0;
+    frame_data_ = nullptr;
+    frame_dirty_ = false;
+    frame_hw_ = false;
+
+    retro_game_info game{ rom_path_.c_str(), nullptr, 0, nullptr };
+    if (!retro_load_game_(&game)) {
+        std::cerr << "[core] retro_load_game failed for " << rom_path_ << "\n";
+        return false;
+    }
+
+    if (boot_.enabled() && retro_get_system_info_) {
+        // core build = name, version and library size; a rebuild invalidates the snapshots
+        retro_system_info info{};
+        retro_get_system_info_(&info);
+        std::string name = info.library_name ? info.library_name : "";
+        std::error_code ec;
+        auto lib_size = std::filesystem::file_size(core_path_, ec);
+        std::string build = name + "|" + (info.library_version ? info.library_version : "") +
+            "|" + std::to_string(ec ? 0 : lib_size);
+        boot_.prepare(name, build);
     }
+    return true;
+}
+
+// Lgica de Inicializao de udio com Fallbacks
+void LibretroCore::open_audio() {
+    StartupTimeline::Scope span(timeline_, "audio.open");
+    int requestedSampleRate = sample_rate_core_;
+    std::cerr << "[audio] core requested sample_rate = " << requestedSampleRate << "\n";
 
     std::vector<int> candidates;
     if (requestedSampleRate > 0) candidates.push_back(requestedSampleRate);
@@ -117,78 +383,649 @@ bool LibretroCore::load(const char* rom_path) {
     if (!audio_ok) {
         std::cerr << "[audio] WARNING: audio device not initialized; continuing without audio\n";
     }
+}
+
+void LibretroCore::join_load() {
+    if (loader_.joinable()) loader_.join();
+    // started by the loader, so only looked at once it is joined
+    if (audio_thread_.joinable()) audio_thread_.join();
+}
+
+bool LibretroCore::finish_load() {
+    bool gl_ok = true;
+    if (!sdl_video_ && gl_output_ && !render_pass_) {
+        // shaders compile on this (GL) thread while the core library loads
+        StartupTimeline::Scope span(timeline_, "gl.shaders");
+        render_pass_ = new GameRenderPass();
+        render_pass_->init_shader_cache("cache/shaders", gl_loader_);
+        render_pass_->set_output_framebuffer(out_fbo_);
+        gl_ok = render_pass_->init(out_w_, out_h_);
+        render_pass_->set_stats(&stats_);
+        if (gl_ok && !shader_preset_.empty()) render_pass_->load_preset(shader_preset_);
+    }
+
+    join_load();
+    if (!gl_ok) {
+        std::cerr << "[video] failed to build the built-in shaders\n";
+        return false;
+    }
+    if (load_ok_ && !host_) load_ok_ = init_game();
+    if (!load_ok_) return false;
+
+    StartupTimeline::Scope span(timeline_, "core.finish");
+    if (!sdl_video_ && gl_output_) {
+        // OpenGL Texture
+        video_.init(1, 1);
+        upload_timer_.init();
+    }
+    return start_game();
+}
+
+bool LibretroCore::start_game() {
+    if (host_) {
+        // SRAM and the boot snapshot are handled by the host's own LibretroCore
+        rotation_ = host_->rotation();
+        aspect_ = host_->aspect();
+        sample_rate_core_ = static_cast<int>(host_->sample_rate() + 0.5);
+        fps_ = (int)host_->fps();
+        timing_fps_ = host_->fps();
+        frame_data_ = nullptr;
+        frame_dirty_ = false;
+        frame_hw_ = false;
+        game_loaded_ = true;
+        return true;
+    }
+
+    // the core defined everything it will by now
+    options_.warn_undefined();
+
+    // geometry is only final once the game is loaded
+    retro_system_av_info av;
+    std::memset(&av, 0, sizeof(av));
+    retro_get_system_av_info_(&av);
+    set_geometry(av.geometry);
+    // timing too, it can differ per game
+    sample_rate_core_ = static_cast<int>(av.timing.sample_rate + 0.5);
+    fps_ = (int)av.timing.fps;
+    timing_fps_ = av.timing.fps;
+
+    if (hw_render_enabled_ && !gl_output_) {
+        std::cerr << "[video] HW render needs a GL context\n";
+        return false;
+    }
+    if (hw_render_enabled_ && !init_hw_context(av.geometry)) {
+        std::cerr << "[video] failed to create HW render framebuffer\n";
+        return false;
+    }
+
+    // SRAM so existe depois do load_game; jogos sem bateria devolvem tamanho 0
+    void* sram = nullptr;
+    size_t sram_size = 0;
+    if (retro_get_memory_data_ && retro_get_memory_size_) {
+        sram = retro_get_memory_data_(RETRO_MEMORY_SAVE_RAM);
+        sram_size = retro_get_memory_size_(RETRO_MEMORY_SAVE_RAM);
+        if (sram && sram_size) sram_.open(sram_path_, sram, sram_size);
+    }
+
+    // boot snapshot after the SRAM: the state carries the save RAM it booted with,
+    // the one loaded from disk goes back in after the restore. NVRAM files the core
+    // manages itself cannot be put back, those games boot normally.
+    boot_capture_in_ = 0;
+    size_t state_size = (boot_.enabled() && retro_serialize_size_) ? retro_serialize_size_() : 0;
+    std::string game = std::filesystem::path(sram_path_).stem().string();
+    if (state_size && BootSnapshot::core_keeps_saves("saves", game)) {
+        std::cerr << "[core] boot snapshot off: the core keeps its own saves for " << game << "\n";
+    } else if (state_size) {
+        std::vector<uint8_t> state;
+        std::vector<uint8_t> saved(sram && sram_size ? (const uint8_t*)sram : nullptr,
+                                   sram && sram_size ? (const uint8_t*)sram + sram_size : nullptr);
+        if (boot_.read(state_size, state) && retro_unserialize_(state.data(), state.size())) {
+            if (!saved.empty()) std::memcpy(sram, saved.data(), saved.size());
+            std::cerr << "[core] boot snapshot restored (" << state_size << " bytes)\n";
+        } else {
+            boot_capture_in_ = boot_.frames();
+        }
+    }
+    game_loaded_ = true;
+    return true;
+}
+
+void LibretroCore::capture_boot_snapshot() {
+    size_t size = retro_serialize_size_();
+    std::vector<uint8_t> state(size);
+    if (!size || !retro_serialize_(state.data(), size)) {
+        std::cerr << "[core] boot snapshot: retro_serialize failed\n";
+        return;
+    }
+    boot_.write(std::move(state));
+}
+
+// Fecha o jogo atual; o core continua inicializado
+void LibretroCore::end_game() {
+    if (!game_loaded_) return;
+    if (host_) {
+        host_->stop(); // the frame pointed into its block
+        game_loaded_ = false;
+        frame_data_ = nullptr;
+        frame_dirty_ = false;
+        return;
+    }
+    sram_.close(); // last flush while the core memory is still valid
+    if (options_dirty_ && !options_path_.empty()) {
+        options_.save(options_path_);
+        options_dirty_ = false;
+    }
+    destroy_hw_context(true);
+    retro_unload_game_();
+    game_loaded_ = false;
+    boot_capture_in_ = 0;
+    frame_data_ = nullptr;
+    frame_dirty_ = false;
+}
+
+bool LibretroCore::switch_content(const char* rom_path, const char* core_path) {
+    join_load();
+    std::string path = core_path ? core_path : kCorePath;
+    bool same_core = core_handle_ && path == core_path_;
+    bool cached = std::any_of(cores_.begin(), cores_.end(),
+        [&](const CoreLibrary& lib) { return lib.path == path; });
+    double t0 = FrameStats::now_ms();
+    std::string previous_rom = game_loaded_ ? rom_path_ : std::string();
+    std::string previous_core = core_path_;
+
+    audio_.pause(true);
+    end_game();
+
+    bool ok = open_content(rom_path, path);
+    std::cerr << "[core] switched to " << rom_path
+              << (same_core ? " (same core, " : cached ? " (cached core, " : " (core loaded, ")
+              << (FrameStats::now_ms() - t0) << " ms)" << (ok ? "" : " FAILED") << "\n";
+    // the old game is gone already: go back to it rather than sit on a stale frame
+    if (!ok && !previous_rom.empty()) {
+        if (open_content(previous_rom, previous_core))
+            std::cerr << "[core] back on " << previous_rom << "\n";
+        else
+            std::cerr << "[core] cannot reload " << previous_rom << " either, no game loaded\n";
+    }
+
+    audio_.flush();
+    audio_.pause(false);
+    return ok;
+}
+
+bool LibretroCore::open_content(const std::string& rom_path, const std::string& core_path) {
+    bool same_core = core_handle_ && core_path == core_path_;
+    last_run_ms_ = 0.0;
+
+    if (host_) {
+        // a new host process per game; it keeps the --option list itself
+        rom_path_ = rom_path;
+        core_path_ = core_path;
+        return host_->start(rom_path_, core_path_) && start_game();
+    }
+
+    if (same_core) {
+        options_.reset();
+    } else {
+        if (core_handle_) {
+            perf_.report();
+            retro_deinit_();
+            core_handle_ = nullptr;
+        }
+        perf_.clear();
+        frame_time_ = retro_frame_time_callback{};
+        options_.clear();
+    }
+    // --option values outlive the game; the new core gets them on define
+    for (const auto& [key, value] : startup_options_) options_.set(key, value);
+    set_game(rom_path);
+    if (!same_core) {
+        // the new core defines its options on retro_set_environment, after the file is read
+        if (!open_library(core_path)) return false;
+        bind_core();
+        init_core();
+    }
+
+    if (!load_content()) return false;
+    if (!start_game()) {
+        retro_unload_game_();
+        return false;
+    }
+    return true;
+}
+
+// --- HW render (RETRO_ENVIRONMENT_SET_HW_RENDER) ---
+bool LibretroCore::set_hw_render(retro_hw_render_callback* cb) {
+    if (!cb) return false;
+
+    if (sdl_video_) {
+        std::cerr << "[video] HW render needs the OpenGL backend\n";
+        return false;
+    }
+
+    // The window context is 3.3 core; legacy (compatibility) GL cores cannot run on it.
+    bool version_ok = cb->version_major < 3 || (cb->version_major == 3 && cb->version_minor <= 3);
+    if (cb->context_type != RETRO_HW_CONTEXT_OPENGL_CORE || !version_ok) {
+        std::cerr << "[video] HW render context " << (int)cb->context_type << " "
+            << cb->version_major << "." << cb->version_minor << " not supported\n";
+        return false;
+    }
+
+    cb->get_current_framebuffer = hw_get_current_framebuffer;
+    cb->get_proc_address = hw_get_proc_address;
+    hw_render_ = *cb;
+    hw_render_enabled_ = true;
+    return true;
+}
+
+bool LibretroCore::init_hw_context(const retro_game_geometry& geometry) {
+    // after a switch the previous framebuffer is kept if it is big enough and has the same attachments
+    bool reuse = hw_fbo_.id() &&
+        hw_fbo_.width() >= (int)geometry.max_width && hw_fbo_.height() >= (int)geometry.max_height &&
+        hw_fbo_depth_ == hw_render_.depth && hw_fbo_stencil_ == hw_render_.stencil;
+    if (!reuse) {
+        hw_fbo_.shutdown();
+        if (!hw_fbo_.init(geometry.max_width, geometry.max_height, GL_RGBA8,
+            hw_render_.depth, hw_render_.stencil)) {
+            return false;
+        }
+        hw_fbo_depth_ = hw_render_.depth;
+        hw_fbo_stencil_ = hw_render_.stencil;
+        std::cerr << "[video] HW render framebuffer " << hw_fbo_.width() << "x" << hw_fbo_.height() << "\n";
+    }
+
+    if (hw_render_.context_reset) hw_render_.context_reset();
+    restore_gl_state();
+    return true;
+}
+
+void LibretroCore::destroy_hw_context(bool keep_framebuffer) {
+    if (hw_render_enabled_ && hw_render_.context_destroy) hw_render_.context_destroy();
+    hw_render_enabled_ = false;
+    if (!keep_framebuffer) hw_fbo_.shutdown();
+}
 
-    // OpenGL Texture
-    glGenTextures(1, &gl_texture_);
-    glBindTexture(GL_TEXTURE_2D, gl_texture_);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+// --- Frontend-owned software framebuffer ---
+bool LibretroCore::get_software_framebuffer(retro_framebuffer* fb) {
+    // GL path only; the SDL backend and HW cores keep their own buffers
+    // Nor when frames are leased, a lease must outlive render()'s unmap.
+    if (!fb || leasing_ || sdl_video_ || !render_pass_ || hw_render_enabled_) return false;
+    // the mapping is write-combined memory, reading it back would crawl
+    if (fb->access_flags & RETRO_MEMORY_ACCESS_READ) return false;
 
-    render_pass_ = new GameRenderPass();
-    render_pass_->init(1920, 1080);
+    size_t pitch = 0;
+    void* data = video_.map_frame(fb->width, fb->height, pitch);
+    if (!data) return false;
 
-    retro_game_info game{ rom_path, nullptr, 0, nullptr };
-    return retro_load_game_(&game);
+    fb->data = data;
+    fb->pitch = pitch;
+    fb->format = video_.format();
+    fb->memory_flags = 0; // uncached
+    return true;
+}
+
+uintptr_t LibretroCore::hw_framebuffer() const {
+    return hw_fbo_.id();
+}
+
+// The core shares our context; put back whatever state render() relies on.
+void LibretroCore::restore_gl_state() {
+    glBindFramebuffer(GL_FRAMEBUFFER, out_fbo_);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_STENCIL_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_CULL_FACE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 }
 
 void LibretroCore::run() {
-    if (retro_run_) retro_run_();
+    if (!game_loaded_ || (!retro_run_ && !host_)) return;
+    frame_fresh_ = false;
+    audio_frame_.clear();
+    double t0 = FrameStats::now_ms();
+    if (host_) {
+        run_host();
+        stats_.add(stage_core_, FrameStats::now_ms() - t0);
+        return;
+    }
+    if (frame_time_.callback) {
+        // tempo real entre dois run(), ou seja o ritmo do nosso pacer (FrameTimer, vsync,
+        // frame delay ou fast-forward). Passo a passo e primeiro frame: a referencia do core
+        retro_usec_t usec = frame_time_.reference;
+        if (last_run_ms_ > 0.0 && throttle_ != RETRO_THROTTLE_FRAME_STEPPING)
+            usec = (retro_usec_t)((t0 - last_run_ms_) * 1000.0 + 0.5);
+        last_run_ms_ = t0;
+        frame_time_.callback(usec);
+    }
+    retro_run_();
+    if (hw_render_enabled_) restore_gl_state();
+    stats_.add(stage_core_, FrameStats::now_ms() - t0);
+    perf_.end_frame();
+    sram_.tick();
+    if (boot_capture_in_ > 0 && --boot_capture_in_ == 0) capture_boot_snapshot();
+}
+
+// Input masks and axes to the host, its frame and audio back into the usual paths
+void LibretroCore::run_host() {
+    static_assert(CoreHost::kAxes == InputSystem::kAxes, "the host block carries InputSystem's axes");
+    if (input_) input_->poll();
+    uint16_t masks[InputSystem::kMaxPorts];
+    int16_t axes[InputSystem::kMaxPorts * InputSystem::kAxes];
+    for (unsigned p = 0; p < InputSystem::kMaxPorts; ++p) {
+        bool masked = masked_ports_ & (1u << p);
+        masks[p] = masked ? input_masks_[p] : input_ ? input_->buttons(p) : 0;
+        const int16_t* from = masked ? input_axes_[p] : input_ ? input_->axes(p) : nullptr;
+        int16_t* to = axes + p * InputSystem::kAxes;
+        if (from) std::copy(from, from + InputSystem::kAxes, to);
+        else std::fill(to, to + InputSystem::kAxes, (int16_t)0);
+    }
+    // no frame (host late, restarting or given up on): keep presenting the last one
+    if (!host_->run_frame(masks, axes, InputSystem::kMaxPorts, throttle_)) return;
+
+    if (host_->rotation() != rotation_) set_rotation(host_->rotation());
+    aspect_ = host_->aspect();
+    CoreHost::Frame frame = host_->frame();
+    if (frame.fresh) {
+        if (frame.format != video_.format()) set_pixel_format(frame.format);
+        on_video_frame(frame.data, frame.width, frame.height, frame.pitch);
+    }
+    push_audio_batch(host_->audio(), host_->audio_frames());
+}
+
+bool LibretroCore::set_frame_time_callback(const retro_frame_time_callback* cb) {
+    frame_time_ = cb ? *cb : retro_frame_time_callback{};
+    last_run_ms_ = 0.0;
+    if (frame_time_.callback)
+        std::cerr << "[core] frame time callback, reference " << frame_time_.reference << " us\n";
+    return true;
+}
+
+void LibretroCore::get_throttle_state(retro_throttle_state* state) const {
+    state->mode = throttle_;
+    // fast-forward, frame steps and the benchmark have no fixed rate
+    bool fixed = throttle_ == RETRO_THROTTLE_NONE || throttle_ == RETRO_THROTTLE_VSYNC;
+    state->rate = fixed ? (float)timing_fps_ : 0.0f;
+}
+
+void LibretroCore::setThrottle(unsigned mode) {
+    if (mode == throttle_) return;
+    throttle_ = mode;
+    last_run_ms_ = 0.0; // no interval spans a pause or a switch out of fast-forward
 }
 
 void LibretroCore::render() {
-    if (!frame_data_ || !render_pass_) return;
+    if (sdl_video_) {
+        sdl_video_->set_rotation(rotation_);
+        sdl_video_->set_aspect(aspect_);
+        if (frame_dirty_) {
+            double t0 = FrameStats::now_ms();
+            sdl_video_->upload(frame_data_, frame_w_, frame_h_, frame_pitch_);
+            stats_.add(stage_upload_, FrameStats::now_ms() - t0);
+            frame_dirty_ = false;
+        }
+        double t0 = FrameStats::now_ms();
+        sdl_video_->present();
+        stats_.add(stage_present_, FrameStats::now_ms() - t0);
+        return;
+    }
+
+    if (!render_pass_) return;
+
+    render_pass_->set_input_rotation(rotation_);
+    render_pass_->set_input_aspect(aspect_);
+
+    if (frame_hw_) {
+        // Sample the core's FBO directly, no readback
+        render_pass_->set_input_texture(hw_fbo_.texture());
+        render_pass_->set_input_decode(false, RETRO_PIXEL_FORMAT_XRGB8888);
+        render_pass_->set_input_region(
+            (float)frame_w_ / hw_fbo_.width(), (float)frame_h_ / hw_fbo_.height(),
+            !hw_render_.bottom_left_origin);
+        render_pass_->set_input_size(frame_w_, frame_h_);
+        if (frame_dirty_) {
+            render_pass_->next_frame();
+            frame_dirty_ = false;
+        }
+        render_pass_->render();
+        return;
+    }
+
+    if (!frame_data_) return;
+
+    double gpu_ms;
+    while (upload_timer_.poll(gpu_ms))
+        stats_.add(stage_gpu_upload_, gpu_ms);
 
     if (frame_dirty_) {
-        glBindTexture(GL_TEXTURE_2D, gl_texture_);
-        // FBNeo usa RGB565 por padro no seu setup. 2 bytes por pixel.
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame_pitch_ / 2);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB565, frame_w_, frame_h_, 0,
-            GL_RGB, GL_UNSIGNED_SHORT_5_6_5, frame_data_);
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        double t0 = FrameStats::now_ms();
+        upload_timer_.begin();
+        video_.upload(frame_data_, frame_w_, frame_h_, frame_pitch_);
+        upload_timer_.end();
+        stats_.add(stage_upload_, FrameStats::now_ms() - t0);
+        render_pass_->next_frame();
         frame_dirty_ = false;
     }
 
-    render_pass_->set_input_texture(gl_texture_);
+    render_pass_->set_input_texture(video_.texture());
+    render_pass_->set_input_decode(video_.shader_decode(), video_.format());
+    render_pass_->set_input_region(1.0f, 1.0f, true);
+    render_pass_->set_input_size(frame_w_, frame_h_);
     render_pass_->render();
 }
 
+void LibretroCore::set_rotation(unsigned rotation) {
+    rotation_ = rotation & 3;
+    std::cerr << "[video] rotation = " << rotation_ * 90 << " degrees\n";
+}
+
+void LibretroCore::set_geometry(const retro_game_geometry& geometry) {
+    aspect_ = geometry.aspect_ratio;
+    if (aspect_ <= 0.0f && geometry.base_height > 0)
+        aspect_ = (float)geometry.base_width / geometry.base_height;
+}
+
+bool LibretroCore::set_pixel_format(retro_pixel_format fmt) {
+    switch (fmt) {
+    case RETRO_PIXEL_FORMAT_0RGB1555:
+    case RETRO_PIXEL_FORMAT_RGB565:
+    case RETRO_PIXEL_FORMAT_XRGB8888:
+        video_.set_format(fmt);
+        if (sdl_video_) sdl_video_->set_format(fmt);
+        std::cerr << "[video] core pixel format = " << (int)fmt << "\n";
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool LibretroCore::setShaderPreset(const std::string& path) {
+    shader_preset_ = path;
+    // before load() the preset is applied once the render pass exists
+    if (!render_pass_) return true;
+    if (path.empty()) {
+        render_pass_->clear_preset();
+        return true;
+    }
+    return render_pass_->load_preset(path);
+}
+
+bool LibretroCore::setCoreOption(const std::string& key, const std::string& value) {
+    if (host_) {
+        // validated (and saved per game) by the host; sent to it while it runs
+        return host_->set_option(key, value);
+    }
+    if (!options_.set(key, value)) {
+        std::cerr << "[core] option " << key << ": invalid value \"" << value << "\"\n";
+        return false;
+    }
+    // only runtime changes are saved; --option values stay out of the game's file
+    // and are applied again to every game switch_content() loads
+    if (game_loaded_) {
+        options_dirty_ = true;
+        return true;
+    }
+    auto found = std::find_if(startup_options_.begin(), startup_options_.end(),
+        [&](const std::pair<std::string, std::string>& o) { return o.first == key; });
+    if (found != startup_options_.end()) found->second = value;
+    else startup_options_.emplace_back(key, value);
+    return true;
+}
+
 void LibretroCore::on_video_frame(const void* data, unsigned w, unsigned h, size_t pitch) {
+    // NULL = duplicate frame, keep presenting the previous one
+    if (!data) return;
+
+    if (data == RETRO_HW_FRAME_BUFFER_VALID) {
+        frame_hw_ = true;
+        frame_w_ = w; frame_h_ = h;
+        frame_dirty_ = true;
+        frame_fresh_ = true;
+        return;
+    }
+
+    frame_hw_ = false;
     frame_data_ = data;
     frame_w_ = w; frame_h_ = h; frame_pitch_ = (int)pitch;
     frame_dirty_ = true;
+    frame_fresh_ = true;
 }
 
 // --- udio ---
 void LibretroCore::push_audio_sample(int16_t l, int16_t r) {
     int16_t buf[2] = { l, r };
+    audio_frame_.insert(audio_frame_.end(), buf, buf + 2);
     audio_.push(buf, 1, sample_rate_core_);
 }
 
 void LibretroCore::push_audio_batch(const int16_t* data, size_t frames) {
+    // the capacity survives clear(), after the first frames this does not allocate
+    audio_frame_.insert(audio_frame_.end(), data, data + frames * 2);
     audio_.push(data, frames, sample_rate_core_);
 }
 
+// --- IEmulatorCore ---
+bool LibretroCore::loadROM(const std::string& path) {
+    leasing_ = true;
+    // the running game is replaced in place, on the same core
+    if (game_loaded_) return switch_content(path.c_str(), core_path_.c_str());
+    return load(path.c_str());
+}
+
+void LibretroCore::reset() {
+    if (retro_reset_ && game_loaded_) retro_reset_();
+}
+
+size_t LibretroCore::stateSize() const {
+    return (retro_serialize_size_ && game_loaded_) ? retro_serialize_size_() : 0;
+}
+
+bool LibretroCore::saveState(void* data, size_t size) {
+    return retro_serialize_ && game_loaded_ && retro_serialize_(data, size);
+}
+
+bool LibretroCore::loadState(const void* data, size_t size) {
+    return retro_unserialize_ && game_loaded_ && retro_unserialize_(data, size);
+}
+
+IEmulatorCore::FrameLease LibretroCore::leaseFrame() const {
+    FrameLease lease;
+    lease.fresh = frame_fresh_;
+    lease.width = frame_w_;
+    lease.height = frame_h_;
+    if (frame_hw_) {
+        lease.format = PixelFormat::Hardware;
+        return lease;
+    }
+    if (!frame_data_) return lease;
+
+    lease.data = frame_data_;
+    lease.pitch = frame_pitch_;
+    switch (video_.format()) {
+    case RETRO_PIXEL_FORMAT_0RGB1555: lease.format = PixelFormat::XRGB1555; break;
+    case RETRO_PIXEL_FORMAT_XRGB8888: lease.format = PixelFormat::XRGB8888; break;
+    default:                          lease.format = PixelFormat::RGB565; break;
+    }
+    return lease;
+}
+
+IEmulatorCore::AudioView LibretroCore::audioFrame() const {
+    AudioView view;
+    view.samples = audio_frame_.data();
+    view.frames = audio_frame_.size() / 2;
+    view.sample_rate = sample_rate_core_;
+    return view;
+}
+
+void LibretroCore::setInputMask(unsigned port, uint16_t mask) {
+    if (port >= InputSystem::kMaxPorts) return;
+    input_masks_[port] = mask;
+    masked_ports_ |= 1u << port;
+}
+
+void LibretroCore::setInputAxes(unsigned port, const int16_t* axes) {
+    if (port >= InputSystem::kMaxPorts) return;
+    std::copy(axes, axes + InputSystem::kAxes, input_axes_[port]);
+}
+
 // --- Input ---
 void RETRO_CALLCONV LibretroCore::input_poll_cb() {
-    if (s_instance && s_instance->input_ && s_instance->window_) {
-        s_instance->input_->update(s_instance->window_);
+    if (s_instance && s_instance->input_) {
+        s_instance->input_->poll();
     }
 }
 
 int16_t RETRO_CALLCONV LibretroCore::input_state_cb(unsigned port, unsigned device, unsigned index, unsigned id) {
-    if (port == 0 && device == RETRO_DEVICE_JOYPAD && s_instance) {
-        return s_instance->input_state(id);
-    }
-    return 0;
+    return s_instance ? s_instance->input_state(port, device, index, id) : 0;
 }
 
-int16_t LibretroCore::input_state(unsigned id) {
-    return input_ ? input_->state(id) : 0;
+int16_t LibretroCore::input_state(unsigned port, unsigned device, unsigned index, unsigned id) {
+    int16_t value;
+    if (port < InputSystem::kMaxPorts && (masked_ports_ & (1u << port))) {
+        if ((device & RETRO_DEVICE_MASK) == RETRO_DEVICE_ANALOG)
+            return InputSystem::analog_state(input_masks_[port], input_axes_[port], index, id);
+        if ((device & RETRO_DEVICE_MASK) != RETRO_DEVICE_JOYPAD) return 0;
+        if (id == RETRO_DEVICE_ID_JOYPAD_MASK) value = (int16_t)input_masks_[port];
+        else value = id < 16 ? (int16_t)((input_masks_[port] >> id) & 1) : 0;
+    } else {
+        value = input_ ? input_->state(port, device, index, id) : 0;
+    }
+    // a button during the boot frames (coin, start) must not end up in the snapshot:
+    // the player wins, this launch captures nothing
+    if (boot_capture_in_ > 0 && value && (device & RETRO_DEVICE_MASK) == RETRO_DEVICE_JOYPAD) {
+        boot_capture_in_ = 0;
+        std::cerr << "[core] boot snapshot skipped, input during boot\n";
+    }
+    return value;
 }
 
 void LibretroCore::unload() {
+    join_load();
     audio_.shutdown();
-    if (retro_unload_game_) retro_unload_game_();
-    if (retro_deinit_) retro_deinit_();
-    if (core_handle_) FreeLibrary(core_handle_);
+    destroy_hw_context();
+    upload_timer_.shutdown();
+    video_.shutdown();
+    end_game();
+    boot_.wait();
+    if (core_handle_) {
+        perf_.report();
+        retro_deinit_();
+        core_handle_ = nullptr;
+    }
+    perf_.clear();
+    frame_time_ = retro_frame_time_callback{};
+    last_run_ms_ = 0.0;
+    close_libraries();
+}
+
+void LibretroCore::close_libraries() {
+    for (const CoreLibrary& lib : cores_) {
+#ifdef _WIN32
+        FreeLibrary(lib.handle);
+#else
+        dlclose(lib.handle);
+#endif
+    }
+    cores_.clear();
+    core_handle_ = nullptr;
 }
\ No newline at end of file
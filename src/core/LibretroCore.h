@@ -1,6 +1,13 @@
 #pragma once
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -9,13 +16,61 @@
 #include "../input/InputSystem.h"
 #include "../audio/AudioSystem.h"
 #include "../video/GameRenderPass.h"
+#include "../video/LibretroVideo.h"
+#include "../video/Framebuffer.h"
+#include "../video/GLContext.h"
+#include "../video/GpuTimer.h"
+#include "../video/VideoSystem.h"
+#include "../FrameStats.h"
+#include "../StartupTimeline.h"
+#include "BootSnapshot.h"
+#include "CoreHost.h"
+#include "IEmulatorCore.h"
+#include "CoreOptions.h"
+#include "CorePerf.h"
+#include "SaveRam.h"
 
-class LibretroCore {
+class LibretroCore : public IEmulatorCore {
 public:
     LibretroCore();
-    ~LibretroCore();
+    ~LibretroCore() override;
 
-    bool load(const char* rom_path);
+    // IEmulatorCore: drives the core without the window, render() or the input devices.
+    // Without setContext() / setVideoSystem() nothing is drawn (HW cores are refused).
+    // loadROM() turns frame leasing on; with a game loaded it goes through switch_content()
+    bool loadROM(const std::string& path) override;
+    void reset() override;
+    void runFrame() override { run(); }
+    void setInput(int player, int buttons) override { setInputMask((unsigned)player, (uint16_t)buttons); }
+    const void* getVideoBuffer() override { return frame_hw_ ? nullptr : frame_data_; }
+    // Leased frames must outlive render(), which unmaps the PBO a core may draw into:
+    // with leasing on the core is never offered the PBO. After load() without
+    // setFrameLeasing(true), a CPU frame is only valid until the next render().
+    FrameLease leaseFrame() const override;
+    AudioView audioFrame() const override;
+    void setInputMask(unsigned port, uint16_t mask) override;
+    // analog axes of a port driven by setInputMask(), InputSystem::kAxes values in SDL order
+    // (the core host forwards the frontend's sticks and triggers this way)
+    void setInputAxes(unsigned port, const int16_t* axes);
+
+    // begin_load() reads the options file and loads the core library on a loader
+    // thread and returns; finish_load() builds the GL render pass on the calling
+    // thread, joins, then runs retro_init and retro_load_game there (the audio
+    // device opens on another thread meanwhile). Every core entry point runs on
+    // the thread that calls finish_load() and run(). Backend, options and timeline
+    // must be set before begin_load(); setContext() only before finish_load().
+    // load() does both.
+    // core_path nullptr = the default core.
+    bool load(const char* rom_path, const char* core_path = nullptr);
+    bool begin_load(const char* rom_path, const char* core_path = nullptr);
+    bool finish_load();
+    // Next game without restarting: the running core only unloads and loads content,
+    // another core is taken from the LRU of loaded libraries (or loaded into it).
+    // Textures, shader programs, framebuffers and the audio device stay alive.
+    // false = the new game failed; the previous one is loaded again if it can be
+    // (gameLoaded() tells whether any game is running)
+    bool switch_content(const char* rom_path, const char* core_path = nullptr);
+    bool gameLoaded() const { return game_loaded_; }
     void unload();
     void run();
     void render();
@@ -23,22 +78,88 @@ public:
     // Setters
     void setInput(InputSystem* input) { input_ = input; }
     void setWindow(GLFWwindow* window) { window_ = window; }
+    // output target, size, GL loader and (if any) the input window
+    void setContext(GLContext* ctx);
+    // SDL_Renderer backend instead of GL; must be set before load(), HW cores are refused
+    void setVideoSystem(VideoSystem* video) { sdl_video_ = video; }
+    void setPixelDecode(PixelDecode decode) { video_.set_decode(decode); }
+    void setTimeline(StartupTimeline* timeline) { timeline_ = timeline; }
+    // frames are read through leaseFrame() / getVideoBuffer(); before the first run()
+    void setFrameLeasing(bool enabled) { leasing_ = enabled; }
+    // run the core in a CoreHost process (software cores only); before load() and
+    // before setCoreOption(), the options are handed to the host
+    void setOutOfProcess(bool enabled);
+    // false: no audio device is opened, samples only reach audioFrame()
+    void setAudioOutput(bool enabled) { audio_output_ = enabled; }
+    // empty path = single built-in pass
+    bool setShaderPreset(const std::string& path);
+    // core option (FBNeo frameskip, cpu clock, ...); before load() it is applied on define
+    // and wins over the game's saved value for this run. Runtime changes reach the core
+    // through GET_VARIABLE_UPDATE and are saved per game.
+    bool setCoreOption(const std::string& key, const std::string& value);
+    CoreOptions& options() { return options_; }
+    // frames after the first boot of a game at which a savestate is cached and then
+    // restored on later loads (skips POST / RAM checks); 0 = off. Before load().
+    void setBootSnapshot(int frames) { boot_.set_frames(frames); }
+    CorePerf& perf() { return perf_; }
+
+    // savestates of the loaded game; 0 / false when the core has none
+    size_t stateSize() const;
+    bool saveState(void* data, size_t size);
+    bool loadState(const void* data, size_t size);
 
     // Callbacks de processamento
     void on_video_frame(const void* data, unsigned w, unsigned h, size_t pitch);
     void push_audio_sample(int16_t l, int16_t r);
     void push_audio_batch(const int16_t* data, size_t frames);
-    int16_t input_state(unsigned id);
+    int16_t input_state(unsigned port, unsigned device, unsigned index, unsigned id);
+    bool set_pixel_format(retro_pixel_format fmt);
+    void set_rotation(unsigned rotation);
+    void set_geometry(const retro_game_geometry& geometry);
+    bool set_hw_render(retro_hw_render_callback* cb);
+    bool get_software_framebuffer(retro_framebuffer* fb);
+    bool set_frame_time_callback(const retro_frame_time_callback* cb);
+    void get_throttle_state(retro_throttle_state* state) const;
+    uintptr_t hw_framebuffer() const;
+    GLADloadproc gl_loader() const { return gl_loader_; }
+
+    // true when the core produced a frame render() has not drawn yet
+    bool has_new_frame() const { return frame_dirty_; }
+    void setPaused(bool paused) { audio_.pause(paused); }
+    // how the main loop paces run(), one of RETRO_THROTTLE_*: NONE (FrameTimer), VSYNC
+    // (frame delay), FAST_FORWARD, FRAME_STEPPING (paused) or UNBLOCKED (benchmark).
+    // A change restarts the frame-time clock, the next callback gets the reference.
+    void setThrottle(unsigned mode);
+    bool fast_forward() const { return throttle_ == RETRO_THROTTLE_FAST_FORWARD; }
 
     int fps() { return fps_; }
+    double timing_fps() const { return timing_fps_; }
+    unsigned rotation() const { return rotation_; }
+    float aspect() const { return aspect_; }
+    FrameStats& stats() { return stats_; }
 
     static LibretroCore* s_instance;
 
 private:
-    FARPROC resolve(const char* name);
+    void* resolve(const char* name);
 
     // libretro pointers
-    HMODULE core_handle_ = nullptr;
+#ifdef _WIN32
+    using CoreHandle = HMODULE;
+#else
+    using CoreHandle = void*;
+#endif
+    CoreHandle core_handle_ = nullptr; // the active library, cores_.front()
+    std::string core_path_;
+
+    // Libraries loaded recently, most recent first. Only the front one is initialised;
+    // the rest stay mapped so switching back to them skips LoadLibrary / dlopen.
+    struct CoreLibrary {
+        std::string path;
+        CoreHandle handle;
+    };
+    static constexpr size_t kMaxCores = 3;
+    std::vector<CoreLibrary> cores_;
     void (*retro_init_)(void) = nullptr;
     void (*retro_run_)(void) = nullptr;
     bool (*retro_load_game_)(const struct retro_game_info*) = nullptr;
@@ -51,24 +172,113 @@ private:
     void (*retro_get_system_av_info_)(struct retro_system_av_info*) = nullptr;
     void (*retro_deinit_)(void) = nullptr;
     void (*retro_unload_game_)(void) = nullptr;
+    void (*retro_reset_)(void) = nullptr;
+    void* (*retro_get_memory_data_)(unsigned) = nullptr;
+    size_t (*retro_get_memory_size_)(unsigned) = nullptr;
+    void (*retro_get_system_info_)(struct retro_system_info*) = nullptr;
+    size_t (*retro_serialize_size_)(void) = nullptr;
+    bool (*retro_serialize_)(void*, size_t) = nullptr;
+    bool (*retro_unserialize_)(const void*, size_t) = nullptr;
 
     // Callbacks estticos para a DLL
     static void RETRO_CALLCONV input_poll_cb();
     static int16_t RETRO_CALLCONV input_state_cb(unsigned port, unsigned device, unsigned index, unsigned id);
 
+    void load_core();  // loader thread: options file and library, no core calls
+    bool init_game();  // GL thread: environment, retro_init, retro_load_game
+    void open_audio(); // audio thread
+    void join_load();
+    bool start_game(); // GL thread, after the loader: geometry, HW context, SRAM
+
+    // Load steps shared by the first load and switch_content()
+    void set_game(const std::string& rom_path); // per-game paths, options file
+    bool open_content(const std::string& rom_path, const std::string& core_path); // switch_content() minus audio
+    bool open_library(const std::string& path);  // LRU lookup or load; makes it active
+    void bind_core();                            // entry points, callbacks, environment
+    void init_core();                            // retro_init + timing
+    bool load_content();                         // retro_load_game(rom_path_)
+    void end_game();                             // SRAM, options, retro_unload_game
+    void run_host();                             // run() out of process
+    void close_libraries();
+    void capture_boot_snapshot();
+
+    bool init_hw_context(const retro_game_geometry& geometry);
+    // keep_framebuffer: warm switch, the next game of the core may reuse hw_fbo_
+    void destroy_hw_context(bool keep_framebuffer = false);
+    void restore_gl_state();
+
     // Video State
-    GLuint gl_texture_ = 0;
+    LibretroVideo video_;
     const void* frame_data_ = nullptr;
     int frame_w_ = 0, frame_h_ = 0, frame_pitch_ = 0;
     bool frame_dirty_ = false;
+    bool frame_hw_ = false;
+    bool frame_fresh_ = false;     // set by the last run()
+    bool leasing_ = false;         // setFrameLeasing(): no PBO for the core
+    std::vector<int16_t> audio_frame_; // what the last run() produced, for audioFrame()
+    uint16_t input_masks_[InputSystem::kMaxPorts] = {};
+    uint32_t masked_ports_ = 0;    // bit per port driven by setInputMask()
+    int16_t input_axes_[InputSystem::kMaxPorts][InputSystem::kAxes] = {};
+    bool gl_output_ = false;       // setContext() was called
     GameRenderPass* render_pass_ = nullptr;
+    VideoSystem* sdl_video_ = nullptr;
+    std::string shader_preset_;
+    unsigned rotation_ = 0;
+    float aspect_ = 0.0f; // display aspect of the unrotated frame, 0 = pixel ratio
+
+    // HW render: the core draws into hw_fbo_ through our GL context
+    retro_hw_render_callback hw_render_{};
+    bool hw_render_enabled_ = false;
+    Framebuffer hw_fbo_;
+    bool hw_fbo_depth_ = false, hw_fbo_stencil_ = false;
 
     // Systems
     InputSystem* input_ = nullptr;
     AudioSystem audio_;
     GLFWwindow* window_ = nullptr;
 
+    // Output (window by default)
+    GLuint out_fbo_ = 0;
+    int out_w_ = 1920;
+    int out_h_ = 1080;
+    GLADloadproc gl_loader_ = (GLADloadproc)glfwGetProcAddress;
+
     int fps_ = 60;
+    double timing_fps_ = 60.0; // exact retro_system_timing::fps, for GET_THROTTLE_STATE
+
+    // SET_FRAME_TIME_CALLBACK: measured interval between two run() calls
+    retro_frame_time_callback frame_time_{};
+    double last_run_ms_ = 0.0; // 0 = no previous frame to measure from
+    unsigned throttle_ = RETRO_THROTTLE_NONE;
+
+    CorePerf perf_;
+    CoreOptions options_;
+    std::string options_path_; // saves/<game>.opt
+    bool options_dirty_ = false;
+    SaveRam sram_;
+    BootSnapshot boot_;
+    int boot_capture_in_ = 0; // frames left before the boot snapshot, 0 = none pending
+    std::string sram_path_;    // saves/<game>.srm
 
     int sample_rate_core_ = 0;
+    bool audio_output_ = true;
+
+    // out of process: the core lives in the host, none of the entry points are bound
+    std::unique_ptr<CoreHost> host_;
+
+    // Startup
+    std::thread loader_;
+    std::thread audio_thread_;
+    std::string rom_path_;
+    bool load_ok_ = false;
+    bool game_loaded_ = false; // retro_load_game succeeded and start_game() ran
+    std::vector<std::pair<std::string, std::string>> startup_options_; // setCoreOption() before a game
+    StartupTimeline* timeline_ = nullptr;
+
+    FrameStats stats_;
+    int stage_core_ = -1;
+    int stage_upload_ = -1;
+    GpuTimer upload_timer_; // GPU side of the texture upload, "gpu.upload"
+    int stage_gpu_upload_ = -1;
+    int stage_present_ = -1; // SDL backend: RenderCopy + RenderPresent, main.cpp times the GL swap
 };
\ No newline at end of file
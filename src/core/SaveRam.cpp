@@ -0,0 +1,258 @@
+#include "SaveRam.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SYNCADE_SSE2 1
+#endif
+
+// true when the n bytes differ anywhere; no early-out, SRAM blocks are small
+static bool block_differs(const uint8_t* a, const uint8_t* b, size_t n) {
+#ifdef SYNCADE_SSE2
+    size_t i = 0;
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        acc = _mm_or_si128(acc, _mm_xor_si128(x, y));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF) return true;
+    return i < n && std::memcmp(a + i, b + i, n - i) != 0;
+#else
+    return std::memcmp(a, b, n) != 0;
+#endif
+}
+
+void SaveRam::set_stats(FrameStats* stats) {
+    stats_ = stats;
+    stage_ = stats ? stats->stage("sram") : -1;
+}
+
+bool SaveRam::open(const std::string& path, void* data, size_t size) {
+    close();
+    if (!data || size == 0) return false;
+
+    // saves/ does not exist on a fresh install
+    std::error_code ec;
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+
+    size_t old_size = 0;
+    if (!map(path, size, old_size)) {
+        std::cerr << "[core] cannot map save RAM file " << path << "\n";
+        return false;
+    }
+
+    path_ = path;
+    data_ = (const uint8_t*)data;
+    size_ = size;
+    blocks_ = (size + kBlock - 1) / kBlock;
+
+    // what is on disk goes into the core; a shorter or new file keeps the core's init
+    if (old_size > 0) std::memcpy(data, map_, (std::min)(old_size, size));
+
+    // the snapshot mirrors the file, so the first compare writes whatever differs
+    shadow_.assign(map_, map_ + size);
+    pending_.assign(blocks_, 0);
+    has_pending_ = false;
+    stop_ = false;
+    frames_ = 0;
+    writes_ = 0;
+    bytes_written_ = 0;
+    thread_ = std::thread(&SaveRam::writer, this);
+
+    std::cerr << "[core] save RAM " << path << " (" << size << " bytes"
+              << (old_size ? ", loaded" : ", new") << ")\n";
+    return true;
+}
+
+void SaveRam::close() {
+    if (!map_) return;
+
+    if (thread_.joinable()) {
+        snapshot();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        thread_.join(); // the writer drains pending blocks before it exits
+    }
+
+    std::cerr << "[core] save RAM " << path_ << ": " << writes_.load() << " writes, "
+              << bytes_written_.load() << " bytes\n";
+    unmap();
+    data_ = nullptr;
+    size_ = blocks_ = 0;
+    shadow_.clear();
+    pending_.clear();
+}
+
+void SaveRam::tick() {
+    if (!data_ || ++frames_ < interval_) return;
+    frames_ = 0;
+
+    double t0 = FrameStats::now_ms();
+    snapshot();
+    if (stats_) stats_->add(stage_, FrameStats::now_ms() - t0);
+}
+
+void SaveRam::snapshot() {
+    dirty_.clear();
+    for (size_t b = 0; b < blocks_; ++b) {
+        size_t off = b * kBlock;
+        size_t n = (std::min)(kBlock, size_ - off);
+        if (block_differs(data_ + off, shadow_.data() + off, n)) dirty_.push_back(b);
+    }
+    if (dirty_.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t b : dirty_) {
+            size_t off = b * kBlock;
+            std::memcpy(shadow_.data() + off, data_ + off, (std::min)(kBlock, size_ - off));
+            pending_[b] = 1;
+        }
+        has_pending_ = true;
+    }
+    wake_.notify_one();
+}
+
+void SaveRam::writer() {
+    std::vector<uint8_t> local(size_);
+    std::vector<size_t> blocks;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return has_pending_ || stop_; });
+        if (!has_pending_) break;
+
+        // copy out under the lock; touching the mapping can block on I/O
+        blocks.clear();
+        for (size_t b = 0; b < blocks_; ++b) {
+            if (!pending_[b]) continue;
+            pending_[b] = 0;
+            size_t off = b * kBlock;
+            std::memcpy(local.data() + off, shadow_.data() + off, (std::min)(kBlock, size_ - off));
+            blocks.push_back(b);
+        }
+        has_pending_ = false;
+        lock.unlock();
+
+        // one store + flush per run of adjacent blocks
+        for (size_t i = 0; i < blocks.size();) {
+            size_t j = i + 1;
+            while (j < blocks.size() && blocks[j] == blocks[j - 1] + 1) ++j;
+            size_t off = blocks[i] * kBlock;
+            size_t end = (std::min)((blocks[j - 1] + 1) * kBlock, size_);
+            std::memcpy(map_ + off, local.data() + off, end - off);
+            flush(off, end - off);
+            ++writes_;
+            bytes_written_ += end - off;
+            i = j;
+        }
+
+        lock.lock();
+    }
+}
+
+#ifdef _WIN32
+bool SaveRam::map(const std::string& path, size_t size, size_t& old_size) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+        nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER current;
+    old_size = GetFileSizeEx(file, &current) ? (size_t)current.QuadPart : 0;
+    if (old_size > size) {
+        // a stale larger file is cut to the core's size; a smaller one grows with the mapping
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)size;
+        SetFilePointerEx(file, end, nullptr, FILE_BEGIN);
+        SetEndOfFile(file);
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+        (DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xFFFFFFFFu), nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    file_ = file;
+    mapping_ = mapping;
+    map_ = (uint8_t*)view;
+    return true;
+}
+
+void SaveRam::unmap() {
+    if (map_) {
+        FlushViewOfFile(map_, 0);
+        UnmapViewOfFile(map_);
+    }
+    if (mapping_) CloseHandle((HANDLE)mapping_);
+    if (file_) {
+        FlushFileBuffers((HANDLE)file_);
+        CloseHandle((HANDLE)file_);
+    }
+    map_ = nullptr;
+    mapping_ = file_ = nullptr;
+}
+
+void SaveRam::flush(size_t offset, size_t bytes) {
+    FlushViewOfFile(map_ + offset, bytes);
+}
+#else
+bool SaveRam::map(const std::string& path, size_t size, size_t& old_size) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+
+    struct stat st;
+    old_size = (fstat(fd, &st) == 0) ? (size_t)st.st_size : 0;
+    if (old_size != size && ftruncate(fd, (off_t)size) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+
+    fd_ = fd;
+    map_ = (uint8_t*)view;
+    return true;
+}
+
+void SaveRam::unmap() {
+    if (map_) {
+        msync(map_, size_, MS_SYNC);
+        munmap(map_, size_);
+    }
+    if (fd_ >= 0) ::close(fd_);
+    map_ = nullptr;
+    fd_ = -1;
+}
+
+void SaveRam::flush(size_t offset, size_t bytes) {
+    // msync wants a page-aligned start; blocks are 4 KiB, pages may be larger
+    static const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = offset - offset % page;
+    msync(map_ + start, offset + bytes - start, MS_SYNC);
+}
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../FrameStats.h"
+
+// Persists RETRO_MEMORY_SAVE_RAM to saves/<game>.srm without stalling the frame.
+// Every interval frames tick() compares the live SRAM with the last snapshot in
+// 4 KiB blocks (SSE2); only changed blocks are copied and a writer thread stores
+// them in a memory-mapped file and flushes just those pages. A game that does
+// not touch its SRAM costs one compare per interval and no I/O at all.
+class SaveRam {
+public:
+    static constexpr size_t kBlock = 4096;
+
+    ~SaveRam() { close(); }
+
+    // maps path at size bytes, copies what was saved into data and starts the writer
+    bool open(const std::string& path, void* data, size_t size);
+    // last compare, waits for the writer to flush everything, unmaps
+    void close();
+
+    // frames between two compares (default 60)
+    void set_interval(int frames) { interval_ = frames < 1 ? 1 : frames; }
+    void set_stats(FrameStats* stats);
+
+    // after retro_run
+    void tick();
+
+private:
+    // compares against shadow_ and queues the changed blocks; main thread only
+    void snapshot();
+    void writer();
+
+    bool map(const std::string& path, size_t size, size_t& old_size);
+    void unmap();
+    void flush(size_t offset, size_t bytes);
+
+    std::string path_;
+    const uint8_t* data_ = nullptr; // core memory
+    size_t size_ = 0;
+    size_t blocks_ = 0;
+    int interval_ = 60;
+    int frames_ = 0;
+    std::vector<size_t> dirty_; // scratch for snapshot()
+
+    // shadow_ is written by the main thread under mutex_ and read by the writer
+    // under mutex_; the compare reads it without locking (only main writes it)
+    std::vector<uint8_t> shadow_;
+    std::vector<uint8_t> pending_; // one flag per block
+    bool has_pending_ = false;
+    bool stop_ = false;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::thread thread_;
+
+    std::atomic<uint64_t> writes_{0};
+    std::atomic<uint64_t> bytes_written_{0};
+
+    uint8_t* map_ = nullptr;
+#ifdef _WIN32
+    void* file_ = nullptr;    // HANDLE
+    void* mapping_ = nullptr; // HANDLE
+#else
+    int fd_ = -1;
+#endif
+
+    FrameStats* stats_ = nullptr;
+    int stage_ = -1;
+};
@@ -1,28 +1,355 @@
 #include "InputSystem.h"
+#include <iostream>
+
+InputSystem* InputSystem::s_instance = nullptr;
+
+// Layout libretro (RetroPad): B embaixo, A a direita, Y a esquerda, X em cima
+static int retro_button(Uint8 button) {
+    switch (button) {
+    case SDL_CONTROLLER_BUTTON_A:             return RETRO_DEVICE_ID_JOYPAD_B;
+    case SDL_CONTROLLER_BUTTON_B:             return RETRO_DEVICE_ID_JOYPAD_A;
+    case SDL_CONTROLLER_BUTTON_X:             return RETRO_DEVICE_ID_JOYPAD_Y;
+    case SDL_CONTROLLER_BUTTON_Y:             return RETRO_DEVICE_ID_JOYPAD_X;
+    case SDL_CONTROLLER_BUTTON_BACK:          return RETRO_DEVICE_ID_JOYPAD_SELECT;
+    case SDL_CONTROLLER_BUTTON_START:         return RETRO_DEVICE_ID_JOYPAD_START;
+    case SDL_CONTROLLER_BUTTON_LEFTSTICK:     return RETRO_DEVICE_ID_JOYPAD_L3;
+    case SDL_CONTROLLER_BUTTON_RIGHTSTICK:    return RETRO_DEVICE_ID_JOYPAD_R3;
+    case SDL_CONTROLLER_BUTTON_LEFTSHOULDER:  return RETRO_DEVICE_ID_JOYPAD_L;
+    case SDL_CONTROLLER_BUTTON_RIGHTSHOULDER: return RETRO_DEVICE_ID_JOYPAD_R;
+    case SDL_CONTROLLER_BUTTON_DPAD_UP:       return RETRO_DEVICE_ID_JOYPAD_UP;
+    case SDL_CONTROLLER_BUTTON_DPAD_DOWN:     return RETRO_DEVICE_ID_JOYPAD_DOWN;
+    case SDL_CONTROLLER_BUTTON_DPAD_LEFT:     return RETRO_DEVICE_ID_JOYPAD_LEFT;
+    case SDL_CONTROLLER_BUTTON_DPAD_RIGHT:    return RETRO_DEVICE_ID_JOYPAD_RIGHT;
+    default:                                  return -1;
+    }
+}
+
+// gatilho conta como L2/R2 digital a partir da metade do curso
+static constexpr int16_t kTriggerThreshold = 16384;
 
 InputSystem::InputSystem() {
-    binds_[RETRO_DEVICE_ID_JOYPAD_UP] = GLFW_KEY_UP;
-    binds_[RETRO_DEVICE_ID_JOYPAD_DOWN] = GLFW_KEY_DOWN;
-    binds_[RETRO_DEVICE_ID_JOYPAD_LEFT] = GLFW_KEY_LEFT;
-    binds_[RETRO_DEVICE_ID_JOYPAD_RIGHT] = GLFW_KEY_RIGHT;
-    binds_[RETRO_DEVICE_ID_JOYPAD_A] = GLFW_KEY_X;
-    binds_[RETRO_DEVICE_ID_JOYPAD_B] = GLFW_KEY_Z;
-    binds_[RETRO_DEVICE_ID_JOYPAD_X] = GLFW_KEY_S;
-    binds_[RETRO_DEVICE_ID_JOYPAD_Y] = GLFW_KEY_A;
-    binds_[RETRO_DEVICE_ID_JOYPAD_L] = GLFW_KEY_Q;
-    binds_[RETRO_DEVICE_ID_JOYPAD_R] = GLFW_KEY_W;
-    binds_[RETRO_DEVICE_ID_JOYPAD_START] = GLFW_KEY_ENTER;
-    binds_[RETRO_DEVICE_ID_JOYPAD_SELECT] = GLFW_KEY_RIGHT_SHIFT;
-}
-
-void InputSystem::update(GLFWwindow* window) {
-    for (auto const& [retro_id, glfw_key] : binds_) {
-        // Leitura direta do hardware via GLFW
-        states_[retro_id] = (glfwGetKey(window, glfw_key) == GLFW_PRESS) ? 1 : 0;
-    }
-}
-
-int16_t InputSystem::state(unsigned id) const {
-    auto it = states_.find(id);
-    return (it != states_.end()) ? it->second : 0;
-}
\ No newline at end of file
+    s_instance = this;
+    keys_.fill(-1);
+    scancodes_.fill(SDL_SCANCODE_UNKNOWN);
+
+    keys_[RETRO_DEVICE_ID_JOYPAD_UP] = GLFW_KEY_UP;
+    keys_[RETRO_DEVICE_ID_JOYPAD_DOWN] = GLFW_KEY_DOWN;
+    keys_[RETRO_DEVICE_ID_JOYPAD_LEFT] = GLFW_KEY_LEFT;
+    keys_[RETRO_DEVICE_ID_JOYPAD_RIGHT] = GLFW_KEY_RIGHT;
+    keys_[RETRO_DEVICE_ID_JOYPAD_A] = GLFW_KEY_X;
+    keys_[RETRO_DEVICE_ID_JOYPAD_B] = GLFW_KEY_Z;
+    keys_[RETRO_DEVICE_ID_JOYPAD_X] = GLFW_KEY_S;
+    keys_[RETRO_DEVICE_ID_JOYPAD_Y] = GLFW_KEY_A;
+    keys_[RETRO_DEVICE_ID_JOYPAD_L] = GLFW_KEY_Q;
+    keys_[RETRO_DEVICE_ID_JOYPAD_R] = GLFW_KEY_W;
+    keys_[RETRO_DEVICE_ID_JOYPAD_START] = GLFW_KEY_ENTER;
+    keys_[RETRO_DEVICE_ID_JOYPAD_SELECT] = GLFW_KEY_RIGHT_SHIFT;
+
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_UP] = SDL_SCANCODE_UP;
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_DOWN] = SDL_SCANCODE_DOWN;
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_LEFT] = SDL_SCANCODE_LEFT;
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_RIGHT] = SDL_SCANCODE_RIGHT;
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_A] = SDL_SCANCODE_X;
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_B] = SDL_SCANCODE_Z;
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_X] = SDL_SCANCODE_S;
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_Y] = SDL_SCANCODE_A;
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_L] = SDL_SCANCODE_Q;
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_R] = SDL_SCANCODE_W;
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_START] = SDL_SCANCODE_RETURN;
+    scancodes_[RETRO_DEVICE_ID_JOYPAD_SELECT] = SDL_SCANCODE_RSHIFT;
+}
+
+InputSystem::~InputSystem() {
+    if (sdl_watch_) SDL_DelEventWatch(sdl_event_watch, this);
+    if (open_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(open_mutex_);
+            open_stop_ = true;
+        }
+        open_wake_.notify_one();
+        open_thread_.join();
+    }
+    for (Pad& pad : opened_) SDL_GameControllerClose(pad.controller);
+    for (Pad& pad : pads_) {
+        if (pad.controller) SDL_GameControllerClose(pad.controller);
+    }
+    if (s_instance == this) s_instance = nullptr;
+}
+
+void InputSystem::set_stats(FrameStats* stats) {
+    stats_ = stats;
+    if (stats_) stage_delay_ = stats_->stage("input.delay");
+}
+
+// --- Captura (callbacks) ---
+void InputSystem::attach(GLFWwindow* window) {
+    if (window) glfwSetKeyCallback(window, key_callback);
+}
+
+void InputSystem::attach_sdl() {
+    // chamado dentro de SDL_PumpEvents, antes do evento chegar na fila do SDL
+    if (sdl_watch_) return;
+    SDL_AddEventWatch(sdl_event_watch, this);
+    sdl_watch_ = true;
+}
+
+void InputSystem::attach_gamepads() {
+    if (SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) < 0) {
+        std::cerr << "[input] SDL game controller init failed: " << SDL_GetError() << "\n";
+        return;
+    }
+    // controles ja conectados tambem chegam como SDL_CONTROLLERDEVICEADDED
+    if (!open_thread_.joinable()) open_thread_ = std::thread(&InputSystem::opener, this);
+    attach_sdl();
+}
+
+void InputSystem::pump_sdl() {
+    SDL_PumpEvents();
+    // os eventos ja passaram pelo watch; sem janela SDL ninguem mais os consome
+    SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+}
+
+int InputSystem::pad_port(SDL_JoystickID id) const {
+    for (unsigned p = 0; p < kMaxPorts; ++p) {
+        if (pads_[p].controller && pads_[p].id == id) return (int)p;
+    }
+    return -1;
+}
+
+void InputSystem::add_pad(int device_index) {
+    if (!open_thread_.joinable() || !SDL_IsGameController(device_index)) return;
+    SDL_JoystickID id = SDL_JoystickGetDeviceInstanceID(device_index);
+    if (pad_port(id) >= 0) return;
+    {
+        std::lock_guard<std::mutex> lock(open_mutex_);
+        to_open_.emplace_back(device_index, id);
+    }
+    open_wake_.notify_one();
+}
+
+void InputSystem::opener() {
+    std::unique_lock<std::mutex> lock(open_mutex_);
+    while (true) {
+        open_wake_.wait(lock, [this] { return !to_open_.empty() || open_stop_; });
+        if (open_stop_) break;
+        auto [index, id] = to_open_.front();
+        to_open_.erase(to_open_.begin());
+        lock.unlock();
+
+        // o indice muda se outro controle saiu nesse meio tempo; o instance id nao
+        if (SDL_JoystickGetDeviceInstanceID(index) != id) {
+            index = -1;
+            for (int i = 0; i < SDL_NumJoysticks(); ++i) {
+                if (SDL_JoystickGetDeviceInstanceID(i) == id) index = i;
+            }
+        }
+        SDL_GameController* controller = index >= 0 ? SDL_GameControllerOpen(index) : nullptr;
+        if (!controller && index >= 0)
+            std::cerr << "[input] cannot open controller " << index << ": " << SDL_GetError() << "\n";
+
+        lock.lock();
+        if (controller) {
+            opened_.push_back(Pad{ controller, id });
+            has_opened_.store(true, std::memory_order_release);
+        }
+    }
+}
+
+void InputSystem::adopt_pads() {
+    std::vector<Pad> opened;
+    {
+        std::lock_guard<std::mutex> lock(open_mutex_);
+        opened.swap(opened_);
+        has_opened_.store(false, std::memory_order_relaxed);
+    }
+    for (Pad& pad : opened) {
+        // desconectado (ou ja adotado) enquanto a thread abria
+        if (!SDL_GameControllerGetAttached(pad.controller) || pad_port(pad.id) >= 0) {
+            SDL_GameControllerClose(pad.controller);
+            continue;
+        }
+        unsigned p = 0;
+        while (p < kMaxPorts && pads_[p].controller) ++p;
+        if (p == kMaxPorts) {
+            std::cerr << "[input] no free port for " << SDL_GameControllerName(pad.controller) << "\n";
+            SDL_GameControllerClose(pad.controller);
+            continue;
+        }
+        pads_[p] = pad;
+        std::cerr << "[input] port " << p << ": " << SDL_GameControllerName(pad.controller) << "\n";
+    }
+}
+
+void InputSystem::remove_pad(SDL_JoystickID id) {
+    int p = pad_port(id);
+    if (p < 0) return;
+    SDL_GameControllerClose(pads_[p].controller);
+    pads_[p] = Pad{};
+    // o reset zera os eixos no poll; o ultimo valor coalescido nao pode voltar depois dele
+    for (unsigned a = 0; a < kAxes; ++a) push_axis(p, a, 0);
+    push_event(Event{ FrameStats::now_ms(), (uint8_t)p, 0, Kind::Reset, false });
+    std::cerr << "[input] port " << p << " disconnected\n";
+}
+
+void InputSystem::key_callback(GLFWwindow*, int key, int, int action, int) {
+    if (!s_instance || action == GLFW_REPEAT) return;
+    for (unsigned id = 0; id < kButtons; ++id) {
+        if (s_instance->keys_[id] == key) s_instance->push(kKeyboard, id, action == GLFW_PRESS);
+    }
+}
+
+int SDLCALL InputSystem::sdl_event_watch(void* userdata, SDL_Event* e) {
+    auto* self = static_cast<InputSystem*>(userdata);
+    if (self->has_opened_.load(std::memory_order_acquire)) self->adopt_pads();
+    switch (e->type) {
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+        if (e->key.repeat) break;
+        for (unsigned id = 0; id < kButtons; ++id) {
+            if (self->scancodes_[id] == e->key.keysym.scancode)
+                self->push(kKeyboard, id, e->type == SDL_KEYDOWN);
+        }
+        break;
+    case SDL_CONTROLLERDEVICEADDED:
+        self->add_pad(e->cdevice.which);
+        break;
+    case SDL_CONTROLLERDEVICEREMOVED:
+        self->remove_pad(e->cdevice.which);
+        break;
+    case SDL_CONTROLLERBUTTONDOWN:
+    case SDL_CONTROLLERBUTTONUP: {
+        int port = self->pad_port(e->cbutton.which);
+        int id = retro_button(e->cbutton.button);
+        if (port >= 0 && id >= 0) self->push(port, id, e->type == SDL_CONTROLLERBUTTONDOWN);
+        break;
+    }
+    case SDL_CONTROLLERAXISMOTION: {
+        int port = self->pad_port(e->caxis.which);
+        if (port >= 0 && e->caxis.axis < kAxes) self->push_axis(port, e->caxis.axis, e->caxis.value);
+        break;
+    }
+    }
+    return 1;
+}
+
+void InputSystem::push(unsigned port, unsigned id, bool pressed) {
+    push_event(Event{ FrameStats::now_ms(), (uint8_t)port, (uint8_t)id, Kind::Button, pressed });
+}
+
+void InputSystem::push_axis(unsigned port, unsigned axis, int16_t value) {
+    if (port >= kMaxPorts || axis >= kAxes) return;
+    // gatilhos tambem valem como L2/R2 digitais: a travessia vira evento de botao
+    if (axis == SDL_CONTROLLER_AXIS_TRIGGERLEFT || axis == SDL_CONTROLLER_AXIS_TRIGGERRIGHT) {
+        uint8_t bit = axis == SDL_CONTROLLER_AXIS_TRIGGERLEFT ? 1 : 2;
+        bool pressed = value >= kTriggerThreshold;
+        if (pressed != ((pads_[port].triggers & bit) != 0)) {
+            pads_[port].triggers ^= bit;
+            push(port, bit == 1 ? RETRO_DEVICE_ID_JOYPAD_L2 : RETRO_DEVICE_ID_JOYPAD_R2, pressed);
+        }
+    }
+    axis_latest_[port][axis].store(value, std::memory_order_relaxed);
+    axis_dirty_.fetch_or(uint64_t(1) << (port * kAxes + axis), std::memory_order_release);
+}
+
+void InputSystem::push_event(const Event& ev) {
+    unsigned head = head_.load(std::memory_order_relaxed);
+    if (!spilling_.load(std::memory_order_acquire) &&
+        head - tail_.load(std::memory_order_acquire) < kQueueSize) {
+        queue_[head % kQueueSize] = ev;
+        head_.store(head + 1, std::memory_order_release);
+        return;
+    }
+    // fila cheia (core parado sem poll): guarda em ordem, depois de tudo o que ja esta na fila.
+    // Enquanto houver spill nada mais entra na fila, para o poll nao inverter a ordem.
+    std::lock_guard<std::mutex> lock(spill_mutex_);
+    spill_.push_back(ev);
+    spilling_.store(true, std::memory_order_release);
+}
+
+// --- Consumo (input_poll_cb) ---
+void InputSystem::poll() {
+    std::array<uint16_t, kMaxPorts + 1> tapped{};
+    double now = FrameStats::now_ms();
+
+    auto apply = [&](const Event& ev) {
+        switch (ev.kind) {
+        case Kind::Button: {
+            uint16_t bit = (uint16_t)(1u << ev.id);
+            if (ev.pressed) {
+                held_[ev.port] |= bit;
+                tapped[ev.port] |= bit;
+                if (stats_) stats_->add(stage_delay_, now - ev.t_ms);
+            }
+            else {
+                held_[ev.port] &= (uint16_t)~bit;
+            }
+            break;
+        }
+        case Kind::Reset:
+            held_[ev.port] = 0;
+            tapped[ev.port] = 0;
+            axes_[ev.port].fill(0);
+            break;
+        }
+    };
+
+    auto drain = [&] {
+        unsigned tail = tail_.load(std::memory_order_relaxed);
+        unsigned head = head_.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) apply(queue_[tail % kQueueSize]);
+        tail_.store(tail, std::memory_order_release);
+    };
+
+    if (!spilling_.load(std::memory_order_acquire)) {
+        drain();
+    } else {
+        // a fila tem os eventos mais antigos que o spill; com o lock o produtor espera
+        std::lock_guard<std::mutex> lock(spill_mutex_);
+        drain();
+        for (const Event& ev : spill_) apply(ev);
+        spill_.clear();
+        spilling_.store(false, std::memory_order_release);
+    }
+
+    // eixos depois dos resets: so o ultimo valor de cada eixo importa
+    uint64_t dirty = axis_dirty_.exchange(0, std::memory_order_acquire);
+    for (unsigned p = 0; p < kMaxPorts && dirty; ++p) {
+        for (unsigned a = 0; a < kAxes; ++a) {
+            if (dirty & (uint64_t(1) << (p * kAxes + a)))
+                axes_[p][a] = axis_latest_[p][a].load(std::memory_order_relaxed);
+        }
+    }
+
+    // pressionado agora, ou pressionado e solto desde o ultimo poll
+    for (unsigned p = 0; p < kMaxPorts; ++p)
+        buttons_[p] = held_[p] | tapped[p];
+    buttons_[0] |= held_[kKeyboard] | tapped[kKeyboard];
+}
+
+int16_t InputSystem::state(unsigned port, unsigned device, unsigned index, unsigned id) const {
+    if (port >= kMaxPorts) return 0;
+
+    // subclasses (RETRO_DEVICE_SUBCLASS) contam como o tipo base
+    switch (device & RETRO_DEVICE_MASK) {
+    case RETRO_DEVICE_JOYPAD:
+        if (id == RETRO_DEVICE_ID_JOYPAD_MASK) return (int16_t)buttons_[port];
+        if (id >= kButtons) return 0;
+        return (buttons_[port] >> id) & 1;
+
+    case RETRO_DEVICE_ANALOG:
+        return analog_state(buttons_[port], axes_[port].data(), index, id);
+    }
+    return 0;
+}
+
+int16_t InputSystem::analog_state(uint16_t buttons, const int16_t* axes, unsigned index, unsigned id) {
+    if (index == RETRO_DEVICE_INDEX_ANALOG_BUTTON) {
+        // botoes analogicos: gatilhos com curso, o resto cheio/zero
+        if (id == RETRO_DEVICE_ID_JOYPAD_L2) return axes[SDL_CONTROLLER_AXIS_TRIGGERLEFT];
+        if (id == RETRO_DEVICE_ID_JOYPAD_R2) return axes[SDL_CONTROLLER_AXIS_TRIGGERRIGHT];
+        return (id < kButtons && ((buttons >> id) & 1)) ? 0x7fff : 0;
+    }
+    // LEFT/RIGHT x X/Y casa com LEFTX LEFTY RIGHTX RIGHTY do SDL
+    if (index > RETRO_DEVICE_INDEX_ANALOG_RIGHT || id > RETRO_DEVICE_ID_ANALOG_Y) return 0;
+    return axes[index * 2 + id];
+}
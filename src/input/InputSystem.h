@@ -1,17 +1,121 @@
 #pragma once
-#include <map>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <GLFW/glfw3.h>
+#include <SDL2/SDL.h>
 #include <libretro/libretro.h>
+#include "../FrameStats.h"
 
 class InputSystem {
 public:
+    static constexpr unsigned kMaxPorts = 8;
+    static constexpr unsigned kButtons = 16; // RETRO_DEVICE_ID_JOYPAD_B .. R3
+    static constexpr unsigned kAxes = SDL_CONTROLLER_AXIS_MAX; // LX LY RX RY LT RT
+
     InputSystem();
-    // Atualiza o estado interno perguntando diretamente ao GLFW
-    void update(GLFWwindow* window);
-    // Retorna o estado salvo
-    int16_t state(unsigned id) const;
+    ~InputSystem();
+
+    // Instala os callbacks de teclado (GLFW ou SDL); cada transicao entra na fila com timestamp
+    void attach(GLFWwindow* window);
+    void attach_sdl();
+    // SDL_GameController nas portas 0..7, na ordem em que conectam (hot-plug incluso).
+    // SDL_GameControllerOpen roda numa thread propria; o event watch so pede a
+    // abertura e depois adota o controle pronto. Nada disso passa pelo poll/input_state.
+    void attach_gamepads();
+    // backend GL: o SDL nao tem janela, alguem precisa bombear os eventos do controle
+    static void pump_sdl();
+
+    // input_poll_cb: aplica os eventos pendentes. Um toque que comecou e terminou
+    // desde o ultimo poll ainda aparece como pressionado neste poll.
+    void poll();
+
+    // retro_input_state_t; RETRO_DEVICE_ID_JOYPAD_MASK devolve todos os botoes de uma vez
+    int16_t state(unsigned port, unsigned device, unsigned index, unsigned id) const;
+
+    // bit N = RETRO_DEVICE_ID_JOYPAD N
+    uint16_t buttons(unsigned port) const { return port < kMaxPorts ? buttons_[port] : 0; }
+    // eixos travados no poll, na ordem do SDL (LX LY RX RY LT RT)
+    const int16_t* axes(unsigned port) const { return port < kMaxPorts ? axes_[port].data() : nullptr; }
+    // RETRO_DEVICE_ANALOG de uma porta; state() e as portas com mascara do LibretroCore usam esta
+    static int16_t analog_state(uint16_t buttons, const int16_t* axes, unsigned index, unsigned id);
+
+    // atraso evento -> poll em "input.delay"
+    void set_stats(FrameStats* stats);
+
+    // produtores da fila; seguros a partir de outra thread (um produtor).
+    // Botao e reset nunca se perdem; eixo guarda so o ultimo valor ate o poll.
+    void push(unsigned port, unsigned id, bool pressed);
+    void push_axis(unsigned port, unsigned axis, int16_t value);
 
 private:
-    std::map<unsigned, int> binds_;
-    std::map<unsigned, int16_t> states_;
-};
\ No newline at end of file
+    enum class Kind : uint8_t { Button, Reset };
+    struct Event {
+        double t_ms;
+        uint8_t port;
+        uint8_t id;
+        Kind kind;
+        bool pressed;
+    };
+    static constexpr unsigned kKeyboard = kMaxPorts; // origem do teclado, somada na porta 0
+
+    static constexpr unsigned kQueueSize = 256; // potencia de 2
+
+    static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    static int SDLCALL sdl_event_watch(void* userdata, SDL_Event* e);
+    void push_event(const Event& ev);
+    void add_pad(int device_index); // pede a abertura ao opener()
+    void adopt_pads();              // controles ja abertos -> pads_
+    void opener();
+    void remove_pad(SDL_JoystickID id);
+    int pad_port(SDL_JoystickID id) const;
+
+    // teclas por id do joypad; -1 / SDL_SCANCODE_UNKNOWN = sem bind
+    std::array<int, kButtons> keys_;
+    std::array<SDL_Scancode, kButtons> scancodes_;
+
+    // fila SPSC sem lock: callbacks escrevem head_, poll() consome ate head_
+    std::array<Event, kQueueSize> queue_;
+    std::atomic<unsigned> head_{ 0 };
+    std::atomic<unsigned> tail_{ 0 };
+    // fila cheia (core sem poll): o resto vai para spill_ ate o proximo poll esvaziar tudo
+    std::atomic<bool> spilling_{ false };
+    std::mutex spill_mutex_;
+    std::vector<Event> spill_;
+
+    // eixos: um valor por eixo, sobrescrito a cada movimento; bit port * kAxes + axis = mudou
+    static_assert(kMaxPorts * kAxes <= 64, "axis_dirty_ has one bit per axis");
+    std::array<std::array<std::atomic<int16_t>, kAxes>, kMaxPorts> axis_latest_{};
+    std::atomic<uint64_t> axis_dirty_{ 0 };
+
+    std::array<uint16_t, kMaxPorts + 1> held_{}; // estado real por origem (portas + teclado)
+    std::array<uint16_t, kMaxPorts> buttons_{};  // estado travado visto pelo core
+    std::array<std::array<int16_t, kAxes>, kMaxPorts> axes_{};
+
+    // lado do produtor (event watch)
+    struct Pad {
+        SDL_GameController* controller = nullptr;
+        SDL_JoystickID id = -1;
+        uint8_t triggers = 0; // bit 0 = L2, bit 1 = R2 acima de kTriggerThreshold
+    };
+    std::array<Pad, kMaxPorts> pads_{};
+
+    // thread que abre os controles; open_mutex_ protege to_open_, opened_ e open_stop_
+    std::mutex open_mutex_;
+    std::condition_variable open_wake_;
+    std::vector<std::pair<int, SDL_JoystickID>> to_open_; // device index, instance id
+    std::vector<Pad> opened_;
+    std::atomic<bool> has_opened_{ false };
+    bool open_stop_ = false;
+    std::thread open_thread_;
+
+    FrameStats* stats_ = nullptr;
+    int stage_delay_ = -1;
+    bool sdl_watch_ = false;
+
+    static InputSystem* s_instance;
+};
@@ -1,77 +1,342 @@
 #define SDL_MAIN_HANDLED
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
 #include <Windows.h>
+#endif
 
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "FrameDelay.h"
+#include "StartupTimeline.h"
 #include "Timing.h"
 
+#include "core/CoreHost.h"
 #include "core/LibretroCore.h"
+#include "video/FramePacer.h"
+#include "video/HeadlessContext.h"
+#include "video/WindowContext.h"
 
 int main(int argc, char** argv)
 {
-    if (!glfwInit()) {
-        std::cerr << "GLFW init failed\n";
-        return -1;
+    bool headless = false;
+    bool sdl_backend = false;
+    int prescale = 1;
+    int swap_interval = -1; // -1 = leave the driver default
+    int max_frames = 0;
+    bool on_demand = false;
+    bool frame_delay = false;
+    double frame_delay_ms = -1.0; // < 0 = auto
+    int benchmark_frames = 0;
+    int headless_frames = 600; // --headless without --benchmark stops after these
+    int boot_snapshot = 0; // frames; 0 = no boot snapshot cache
+    bool out_of_process = false;
+    PixelDecode decode = PixelDecode::Driver;
+    int stats_interval = 0;
+    const char* preset = nullptr;
+    std::vector<std::pair<std::string, std::string>> core_options;
+    // --rom path[@core], repeatable; PageUp / PageDown switch between them in place
+    struct Content {
+        std::string rom;
+        std::string core; // empty = default core
+        const char* core_path() const { return core.empty() ? nullptr : core.c_str(); }
+    };
+    std::vector<Content> contents;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--gpu-decode") decode = PixelDecode::Shader;
+        else if (arg == "--stats") stats_interval = 600;
+        else if (arg == "--preset" && i + 1 < argc) preset = argv[++i];
+        else if (arg == "--headless") headless = true;
+        else if (arg == "--benchmark" && i + 1 < argc) benchmark_frames = std::atoi(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc) headless_frames = std::atoi(argv[++i]);
+        else if (arg == "--sdl") sdl_backend = true;
+        else if (arg == "--prescale" && i + 1 < argc) prescale = std::atoi(argv[++i]);
+        else if (arg == "--swap-interval" && i + 1 < argc) swap_interval = std::atoi(argv[++i]);
+        else if (arg == "--max-frames" && i + 1 < argc) max_frames = std::atoi(argv[++i]);
+        else if (arg == "--on-demand") on_demand = true;
+        else if (arg == "--boot-snapshot" && i + 1 < argc) boot_snapshot = std::atoi(argv[++i]);
+        else if (arg == "--out-of-process") out_of_process = true;
+        // started by CoreHost: this process only runs the core
+        else if (arg == "--core-host" && i + 1 < argc) return CoreHost::serve(argv[i + 1]);
+        else if (arg == "--option" && i + 1 < argc) {
+            // --option fbneo-frameskip=1
+            std::string kv = argv[++i];
+            size_t eq = kv.find('=');
+            if (eq != std::string::npos) core_options.emplace_back(kv.substr(0, eq), kv.substr(eq + 1));
+        }
+        else if (arg == "--rom" && i + 1 < argc) {
+            // --rom roms/sonic.md@cores/genesis_plus_gx_libretro.so
+            std::string v = argv[++i];
+            size_t at = v.find('@');
+            if (at == std::string::npos) contents.push_back({ v, "" });
+            else contents.push_back({ v.substr(0, at), v.substr(at + 1) });
+        }
+        else if (arg == "--frame-delay" && i + 1 < argc) {
+            std::string v = argv[++i];
+            frame_delay = true;
+            frame_delay_ms = (v == "auto") ? -1.0 : std::atof(v.c_str());
+        }
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (contents.empty()) contents.push_back({ "roms/sf2ce.zip", "" });
+    size_t current = 0;
 
-    GLFWwindow* window = glfwCreateWindow(1920, 1080, "Syncade", nullptr, nullptr);
-    if (!window) {
-        glfwTerminate();
-        return -1;
+    // startup runs as a small task graph: the options file and the core library
+    // load on a loader thread while this thread creates the window / GL context
+    // and builds the shaders; retro_init and retro_load_game then run here, on the
+    // thread that calls retro_run (audio opens on its own meanwhile)
+    StartupTimeline startup;
+    {
+        StartupTimeline::Scope span(&startup, "sdl.init");
+        if (SDL_Init(SDL_INIT_AUDIO) < 0) {
+            std::cerr << "Erro SDL: " << SDL_GetError() << std::endl;
+        }
     }
 
-    if (SDL_Init(SDL_INIT_AUDIO) < 0) {
-        std::cerr << "Erro SDL: " << SDL_GetError() << std::endl;
+    LibretroCore* core = new LibretroCore();
+    // a crashing or hanging core only takes the host process down
+    core->setOutOfProcess(out_of_process);
+    core->setTimeline(&startup);
+    core->setPixelDecode(decode);
+    core->setBootSnapshot(boot_snapshot);
+    core->stats().set_report_interval(stats_interval);
+    if (preset) core->setShaderPreset(preset);
+    for (const auto& [key, value] : core_options) core->setCoreOption(key, value);
+
+    // the backend has to be known before the core asks for HW render
+    std::unique_ptr<VideoSystem> sdl_video;
+    if (sdl_backend) {
+        sdl_video = std::make_unique<VideoSystem>();
+        sdl_video->set_prescale(prescale);
+        core->setVideoSystem(sdl_video.get());
     }
 
-    LibretroCore* core = new LibretroCore();
+    core->begin_load(contents[current].rom.c_str(), contents[current].core_path());
+
+    // SDL_Renderer backend (CPU path) or GL (window / headless)
+    std::unique_ptr<GLContext> ctx;
+    if (sdl_backend) {
+        StartupTimeline::Scope span(&startup, "sdl.video");
+        if (!sdl_video->init(1920, 1080)) {
+            std::cerr << "Failed to create SDL renderer\n";
+            core->unload();
+            return -1;
+        }
+    } else {
+        StartupTimeline::Scope span(&startup, "gl.context");
+        if (headless) {
+            // no window to close: the paced loop ends after --frames (0 = never)
+            auto offscreen = std::make_unique<HeadlessContext>();
+            offscreen->set_frame_limit(headless_frames);
+            ctx = std::move(offscreen);
+        }
+        else ctx = std::make_unique<WindowContext>();
+
+        if (!ctx->init(1920, 1080)) {
+            std::cerr << "Failed to create GL context\n";
+            core->unload();
+            return -1;
+        }
+    }
 
     InputSystem* input = new InputSystem();
     core->setInput(input);
-    core->setWindow(window); // <-- MUITO IMPORTANTE: passa a janela GLFW para o Core
+    input->set_stats(&core->stats());
+    if (ctx) input->attach(ctx->window());
+    else input->attach_sdl();
+    input->attach_gamepads();
+    if (ctx) core->setContext(ctx.get()); // janela (input), loader GL e framebuffer de saida
 
-    glfwMakeContextCurrent(window);
-
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cerr << "GLAD init failed\n";
-        return -1;
+    // frame delay needs vblank as its clock: a window with vsync
+    if (frame_delay && (!ctx || !ctx->window())) {
+        std::cerr << "[video] --frame-delay needs the GL window, ignored\n";
+        frame_delay = false;
     }
+    if (frame_delay && swap_interval < 0) swap_interval = 1;
 
-    glDisable(GL_DEPTH_TEST);
-    glViewport(0, 0, 1920, 1080);
+    FramePacer pacer;
+    // CPU time blocked in the swap; the final blit's GPU time is the render pass's
+    // own stage ("gpu.input", or the last "gpu.pass<n>" with a preset)
+    int stage_present = core->stats().stage("present");
+    if (ctx) {
+        if (swap_interval >= 0) ctx->set_swap_interval(swap_interval);
+        pacer.set_max_frames(max_frames);
+        pacer.set_stats(&core->stats());
 
-    if (!core->load("roms/sf2ce.zip")) {
+        glDisable(GL_DEPTH_TEST);
+        glViewport(0, 0, ctx->width(), ctx->height());
+    }
+
+    bool loaded = core->finish_load();
+    startup.report();
+    if (!loaded) {
         std::cerr << "Failed to load core\n";
         return -1;
     }
 
-    FrameTimer timer;
-    timer.init(core->fps());
+    if (benchmark_frames > 0) {
+        // throughput run: no pacing and (GL) no present, just emulate + upload + shade
+        core->setThrottle(RETRO_THROTTLE_UNBLOCKED);
+        double start = FrameStats::now_ms();
+        for (int i = 0; i < benchmark_frames; ++i) {
+            if (ctx) {
+                ctx->poll_events();
+                InputSystem::pump_sdl();
+            }
+            else sdl_video->poll_events();
+            core->run();
+
+            if (ctx) {
+                glBindFramebuffer(GL_FRAMEBUFFER, ctx->target_framebuffer());
+                glClearColor(0, 0, 0, 1);
+                glClear(GL_COLOR_BUFFER_BIT);
+            }
+
+            core->render(); // the SDL backend presents here
+            core->stats().end_frame();
+        }
+        if (ctx) glFinish();
+        double elapsed = FrameStats::now_ms() - start;
+        std::cerr << "[bench] " << benchmark_frames << " frames in " << elapsed << " ms = "
+                  << (benchmark_frames * 1000.0 / elapsed) << " fps"
+                  << (ctx ? " (presentation off)" : " (SDL renderer)") << "\n";
+        core->stats().report();
+    } else {
+        FrameTimer timer;
+        timer.init(core->fps());
+
+        // frame delay runs on the display's vblank, not the core's frame rate
+        double present_hz = core->fps();
+        if (frame_delay && ctx->refresh_rate() > 0.0) {
+            present_hz = ctx->refresh_rate() / (swap_interval > 0 ? swap_interval : 1);
+            std::cerr << "[video] display " << ctx->refresh_rate() << " Hz, presenting at "
+                      << present_hz << " Hz\n";
+        }
+        FrameDelay delay;
+        if (frame_delay) {
+            delay.init(present_hz, &core->stats());
+            delay.set_delay(frame_delay_ms);
+        }
+
+        // hotkeys (GL window): P = pause, N = advance one frame while paused,
+        // hold Space = fast-forward (no FrameTimer, frame delay or vsync),
+        // PageDown / PageUp = next / previous --rom
+        GLFWwindow* hotkeys = ctx ? ctx->window() : nullptr;
+        bool paused = false;
+        bool pause_held = false, advance_held = false;
+        bool next_held = false, prev_held = false;
+        bool fast_forward = false;
+        const unsigned paced = frame_delay ? RETRO_THROTTLE_VSYNC : RETRO_THROTTLE_NONE;
+        core->setThrottle(paced);
+
+        while (true) {
+            if (ctx) {
+                if (ctx->should_close()) break;
+                // paused: sleep in the event queue instead of spinning in timer.sync()
+                if (paused) ctx->wait_events();
+                // frame delay: sleep out most of the frame so input is read right before vblank
+                else if (frame_delay && !fast_forward) delay.wait();
+                pacer.begin_frame();
+                if (!paused) ctx->poll_events();
+                InputSystem::pump_sdl(); // controles (hot-plug, botoes, eixos)
+            } else if (!sdl_video->poll_events()) {
+                break;
+            }
+
+            bool advance = false;
+            if (hotkeys) {
+                bool pause_key = glfwGetKey(hotkeys, GLFW_KEY_P) == GLFW_PRESS;
+                bool advance_key = glfwGetKey(hotkeys, GLFW_KEY_N) == GLFW_PRESS;
+                if (pause_key && !pause_held) {
+                    paused = !paused;
+                    core->setPaused(paused);
+                    if (!paused) timer.init(core->fps()); // no catch-up burst after the pause
+                    std::cerr << (paused ? "[video] paused\n" : "[video] resumed\n");
+                }
+                advance = paused && advance_key && !advance_held;
+                pause_held = pause_key;
+                advance_held = advance_key;
+
+                bool ff_key = !paused && glfwGetKey(hotkeys, GLFW_KEY_SPACE) == GLFW_PRESS;
+                if (ff_key != fast_forward) {
+                    fast_forward = ff_key;
+                    if (swap_interval > 0) ctx->set_swap_interval(fast_forward ? 0 : swap_interval);
+                    if (!fast_forward) timer.init(core->fps());
+                }
+                bool next_key = glfwGetKey(hotkeys, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS;
+                bool prev_key = glfwGetKey(hotkeys, GLFW_KEY_PAGE_UP) == GLFW_PRESS;
+                if (contents.size() > 1 && ((next_key && !next_held) || (prev_key && !prev_held))) {
+                    size_t previous = current;
+                    current = (current + (next_key ? 1 : contents.size() - 1)) % contents.size();
+                    if (!core->switch_content(contents[current].rom.c_str(), contents[current].core_path())) {
+                        current = previous; // switch_content() went back to it
+                        if (!core->gameLoaded()) {
+                            std::cerr << "[host] no game left to run\n";
+                            break;
+                        }
+                    }
+                    core->setPaused(paused);
+                    // the new game may run at another rate
+                    timer.init(core->fps());
+                    if (frame_delay) {
+                        delay.init(present_hz, &core->stats());
+                        delay.set_delay(frame_delay_ms);
+                    }
+                }
+                next_held = next_key;
+                prev_held = prev_key;
+
+                core->setThrottle(paused ? RETRO_THROTTLE_FRAME_STEPPING
+                                  : fast_forward ? RETRO_THROTTLE_FAST_FORWARD : paced);
+            }
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+            if (!paused || advance) {
+                core->run();
+                // with frame delay vsync paces
+                if (!paused && !frame_delay && !fast_forward) timer.sync();
+            }
 
-        core->run();
-        timer.sync();
+            // on demand (and always while paused): draw only a new frame or a damaged window.
+            // Not with frame delay, the vsync'd swap is what paces that loop.
+            bool damaged = ctx ? ctx->take_damage() : sdl_video->take_damage();
+            if (((on_demand && !frame_delay) || paused) && !core->has_new_frame() && !damaged) {
+                if (!paused) core->stats().end_frame();
+                continue;
+            }
 
-        glClearColor(0, 0, 0, 1);
-        glClear(GL_COLOR_BUFFER_BIT);
+            if (ctx) {
+                glBindFramebuffer(GL_FRAMEBUFFER, ctx->target_framebuffer());
+                glClearColor(0, 0, 0, 1);
+                glClear(GL_COLOR_BUFFER_BIT);
+            }
 
-        core->render();
+            core->render();
 
-        glfwSwapBuffers(window);
+            if (ctx) {
+                bool delayed = frame_delay && !fast_forward;
+                if (delayed) delay.before_present();
+                double t0 = FrameStats::now_ms();
+                ctx->present();
+                core->stats().add(stage_present, FrameStats::now_ms() - t0);
+                if (delayed) delay.presented();
+                pacer.end_frame();
+            }
+            if (!paused) core->stats().end_frame();
+        }
     }
 
     core->unload();
-    glfwTerminate();
+    pacer.shutdown();
+    if (ctx) ctx->shutdown();
+    if (sdl_video) sdl_video->shutdown();
     return 0;
 }
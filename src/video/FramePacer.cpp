@@ -0,0 +1,98 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <iostream>
+
+void FramePacer::set_max_frames(int frames) {
+    if (frames < 0) frames = 0;
+    if (frames > kMaxInFlight) frames = kMaxInFlight;
+    max_frames_ = frames;
+    std::cerr << "[video] max frames in flight = ";
+    if (frames) std::cerr << frames << "\n";
+    else std::cerr << "driver\n";
+}
+
+void FramePacer::set_stats(FrameStats* stats) {
+    stats_ = stats;
+    if (stats_) {
+        stage_latency_ = stats_->stage("latency");
+        stage_done_ = stats_->stage("present.done");
+        stage_wait_ = stats_->stage("pacer.wait");
+    }
+}
+
+bool FramePacer::retire(bool wait) {
+    if (pending_ == 0) return false;
+
+    int oldest = (write_ - pending_ + kMaxInFlight) % kMaxInFlight;
+    // 100 ms cap so a lost context can't hang the loop
+    GLenum r = glClientWaitSync(fences_[oldest], GL_SYNC_FLUSH_COMMANDS_BIT,
+        wait ? 100000000ull : 0);
+    if (r == GL_TIMEOUT_EXPIRED) return false;
+
+    if (stats_ && r != GL_WAIT_FAILED) {
+        // the timestamp precedes the fence, so it is normally available by now
+        GLint available = 0;
+        glGetQueryObjectiv(queries_[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(queries_[oldest], GL_QUERY_RESULT, &ns);
+            double done = ns / 1.0e6 + offsets_[oldest];
+            stats_->add(stage_latency_, (std::max)(0.0, done - starts_[oldest]));
+            stats_->add(stage_done_, (std::max)(0.0, done - presents_[oldest]));
+        }
+    }
+
+    glDeleteSync(fences_[oldest]);
+    fences_[oldest] = nullptr;
+    --pending_;
+    return true;
+}
+
+void FramePacer::begin_frame() {
+    // collect whatever already finished, without blocking
+    while (retire(false)) {}
+
+    if (max_frames_ > 0 && pending_ >= max_frames_) {
+        double t0 = FrameStats::now_ms();
+        while (pending_ >= max_frames_ && retire(true)) {}
+        if (stats_) stats_->add(stage_wait_, FrameStats::now_ms() - t0);
+    }
+
+    frame_start_ = FrameStats::now_ms();
+}
+
+void FramePacer::end_frame() {
+    if (!queries_[0]) glGenQueries(kMaxInFlight, queries_);
+
+    // ring full (no limit set and the GPU is far behind): forget the oldest
+    if (pending_ == kMaxInFlight) {
+        int oldest = (write_ - pending_ + kMaxInFlight) % kMaxInFlight;
+        glDeleteSync(fences_[oldest]);
+        fences_[oldest] = nullptr;
+        --pending_;
+    }
+
+    // GPU clock against ours, to bring the timestamp onto the now_ms() axis
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    double now = FrameStats::now_ms();
+    offsets_[write_] = now - gpu_now / 1.0e6;
+    presents_[write_] = now;
+    // written once the GPU executed everything before it, the present included
+    glQueryCounter(queries_[write_], GL_TIMESTAMP);
+
+    fences_[write_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    starts_[write_] = frame_start_;
+    write_ = (write_ + 1) % kMaxInFlight;
+    ++pending_;
+}
+
+void FramePacer::shutdown() {
+    for (GLsync& f : fences_) {
+        if (f) glDeleteSync(f);
+        f = nullptr;
+    }
+    if (queries_[0]) glDeleteQueries(kMaxInFlight, queries_);
+    for (GLuint& q : queries_) q = 0;
+    write_ = pending_ = 0;
+}
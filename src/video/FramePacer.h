@@ -0,0 +1,44 @@
+#pragma once
+#include <glad/glad.h>
+#include "../FrameStats.h"
+
+// Limits how many presented frames the GPU may still be working on. A fence
+// is inserted right after present; before the next frame starts (and before
+// input is polled) the CPU waits until fewer than max_frames fences are pending.
+// A GL_TIMESTAMP query next to each fence records when the GPU finished the
+// frame, so "latency" (frame start -> GPU done) and "present.done" (present
+// call -> GPU done) do not depend on when the fence happens to be polled.
+class FramePacer {
+public:
+    static constexpr int kMaxInFlight = 4;
+
+    // 1..kMaxInFlight; 0 = no limit, the driver queues as it likes
+    void set_max_frames(int frames);
+    void set_stats(FrameStats* stats);
+
+    // waits for room in the queue, then stamps the frame start
+    void begin_frame();
+    // call right after present
+    void end_frame();
+
+    void shutdown();
+
+private:
+    // retires the oldest fence; wait = block until it signals
+    bool retire(bool wait);
+
+    GLsync fences_[kMaxInFlight] = {};
+    GLuint queries_[kMaxInFlight] = {}; // GL_TIMESTAMP after the present
+    double starts_[kMaxInFlight] = {};
+    double presents_[kMaxInFlight] = {};
+    double offsets_[kMaxInFlight] = {}; // now_ms() - GPU clock, sampled at present
+    int write_ = 0;
+    int pending_ = 0;
+    int max_frames_ = 0;
+    double frame_start_ = 0.0;
+
+    FrameStats* stats_ = nullptr;
+    int stage_latency_ = -1;
+    int stage_done_ = -1;
+    int stage_wait_ = -1;
+};
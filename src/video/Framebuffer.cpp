@@ -1,8 +1,12 @@
 #include "Framebuffer.h"
 #include <iostream>
 
-bool Framebuffer::init(int w, int h)
+bool Framebuffer::init(int w, int h, GLenum format, bool depth, bool stencil)
 {
+    width_ = w;
+    height_ = h;
+    format_ = format;
+
     glGenFramebuffers(1, &fbo_);
     glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
 
@@ -11,7 +15,7 @@ bool Framebuffer::init(int w, int h)
 
     glTexImage2D(
         GL_TEXTURE_2D, 0,
-        GL_RGBA8,
+        format,
         w, h,
         0,
         GL_RGBA,
@@ -30,8 +34,20 @@ bool Framebuffer::init(int w, int h)
         0
     );
 
+    if (depth || stencil) {
+        GLenum depth_format = stencil ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT24;
+        GLenum attachment = stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+
+        glGenRenderbuffers(1, &depth_rb_);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth_rb_);
+        glRenderbufferStorage(GL_RENDERBUFFER, depth_format, w, h);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, depth_rb_);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         std::cerr << "Framebuffer incomplete\n";
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
         return false;
     }
 
@@ -51,6 +67,9 @@ void Framebuffer::unbind()
 
 void Framebuffer::shutdown()
 {
+    if (depth_rb_) glDeleteRenderbuffers(1, &depth_rb_);
     if (color_tex_) glDeleteTextures(1, &color_tex_);
     if (fbo_) glDeleteFramebuffers(1, &fbo_);
+    depth_rb_ = color_tex_ = fbo_ = 0;
+    width_ = height_ = 0;
 }
@@ -3,15 +3,24 @@
 
 class Framebuffer {
 public:
-    bool init(int w, int h);
+    // depth/stencil attach a renderbuffer (packed 24/8 when both are set)
+    bool init(int w, int h, GLenum format = GL_RGBA8, bool depth = false, bool stencil = false);
     void bind();
     void unbind();
 
+    GLuint id() const { return fbo_; }
     GLuint texture() const { return color_tex_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    GLenum format() const { return format_; }
 
     void shutdown();
 
 private:
     GLuint fbo_ = 0;
     GLuint color_tex_ = 0;
+    GLuint depth_rb_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    GLenum format_ = GL_RGBA8;
 };
@@ -0,0 +1,39 @@
+#include "FramebufferPool.h"
+
+void FramebufferPool::begin_frame(int max_idle) {
+    for (size_t i = 0; i < entries_.size();) {
+        Entry& e = *entries_[i];
+        e.idle_frames = e.in_use ? 0 : e.idle_frames + 1;
+        e.in_use = false;
+
+        if (e.idle_frames > max_idle) {
+            e.fb.shutdown();
+            entries_.erase(entries_.begin() + i);
+            continue;
+        }
+        ++i;
+    }
+}
+
+Framebuffer* FramebufferPool::acquire(int w, int h, GLenum format) {
+    for (auto& e : entries_) {
+        if (!e->in_use && e->fb.width() == w && e->fb.height() == h && e->fb.format() == format) {
+            e->in_use = true;
+            return &e->fb;
+        }
+    }
+
+    auto e = std::make_unique<Entry>();
+    if (!e->fb.init(w, h, format)) {
+        e->fb.shutdown();
+        return nullptr;
+    }
+    e->in_use = true;
+    entries_.push_back(std::move(e));
+    return &entries_.back()->fb;
+}
+
+void FramebufferPool::shutdown() {
+    for (auto& e : entries_) e->fb.shutdown();
+    entries_.clear();
+}
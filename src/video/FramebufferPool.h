@@ -0,0 +1,29 @@
+#pragma once
+#include <glad/glad.h>
+#include <memory>
+#include <vector>
+#include "Framebuffer.h"
+
+// Intermediate render targets keyed by size and format. Targets are handed
+// out per frame and kept alive across frames and preset switches; ones that
+// stay unused for max_idle frames are freed.
+class FramebufferPool {
+public:
+    // marks every target free again; call once at the start of a frame
+    void begin_frame(int max_idle = 300);
+
+    Framebuffer* acquire(int w, int h, GLenum format);
+
+    void shutdown();
+
+    size_t size() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        Framebuffer fb;
+        bool in_use = false;
+        int idle_frames = 0;
+    };
+
+    std::vector<std::unique_ptr<Entry>> entries_;
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <glad/glad.h>
+
+struct GLFWwindow;
+
+// Where the GL pipeline runs and presents: a GLFW window or an offscreen
+// (headless) context. init() makes the context current and loads glad.
+class GLContext {
+public:
+    virtual bool init(int w, int h) = 0;
+    virtual void shutdown() = 0;
+
+    virtual void poll_events() = 0;
+    // blocks until an event arrives (paused state); returns at once without a window
+    virtual void wait_events() { poll_events(); }
+    // true once after the window needs repainting (expose, resize); clears the flag
+    virtual bool take_damage() { return false; }
+    virtual bool should_close() = 0;
+    virtual void present() = 0;
+    // vsync: 0 = off, 1 = every vblank, N = every Nth; ignored without a window
+    virtual void set_swap_interval(int /*interval*/) {}
+    // refresh rate of the display showing the window, in Hz; 0 = unknown or no window
+    virtual double refresh_rate() const { return 0.0; }
+
+    // framebuffer the final image is drawn into (0 for the window)
+    virtual GLuint target_framebuffer() const = 0;
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+
+    // GL entry point lookup, shared with glad, ShaderCache and HW cores
+    virtual GLADloadproc loader() const = 0;
+
+    // keyboard source for InputSystem; nullptr when there is none
+    virtual GLFWwindow* window() const { return nullptr; }
+
+    virtual ~GLContext() = default;
+};
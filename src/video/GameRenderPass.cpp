@@ -1,23 +1,86 @@
 #include "GameRenderPass.h"
+#include "../FrameStats.h"
+#include <algorithm>
 #include <iostream>
 
-static GLuint compile_shader(GLenum type, const char* src)
+GameRenderPass::Program GameRenderPass::locate(GLuint program)
 {
-    GLuint s = glCreateShader(type);
-    glShaderSource(s, 1, &src, nullptr);
-    glCompileShader(s);
-    return s;
+    Program p;
+    p.id = program;
+    p.uv_scale = glGetUniformLocation(p.id, "uv_scale");
+    p.flip_y = glGetUniformLocation(p.id, "flip_y");
+    p.format = glGetUniformLocation(p.id, "format");
+    p.rotation = glGetUniformLocation(p.id, "rotation");
+    return p;
 }
 
-bool GameRenderPass::init(int, int)
+// Vertex stage for preset passes that only provide a fragment shader
+static const char* pass_vs_src = R"(
+    layout(location=0) in vec2 pos;
+    layout(location=1) in vec2 uv;
+    out vec2 v_uv;
+    void main() {
+        v_uv = uv;
+        gl_Position = vec4(pos,0,1);
+    }
+)";
+
+static std::string stage_source(const char* define, const std::string& body)
+{
+    return std::string("#version 330 core\n#define ") + define + "\n" + body;
+}
+
+ShaderCache::Build GameRenderPass::begin_pass(const ShaderPass& desc)
+{
+    bool has_vertex = desc.source.find("VERTEX") != std::string::npos;
+    std::string vs_src = stage_source("VERTEX", has_vertex ? desc.source : pass_vs_src);
+    std::string fs_src = stage_source("FRAGMENT", desc.source);
+    return cache_.begin(desc.path, vs_src, fs_src);
+}
+
+bool GameRenderPass::finish_pass(const ShaderPass& desc, ShaderCache::Build& build, PresetPass& out)
+{
+    out.desc = desc;
+    out.program = cache_.finish(build);
+    if (!out.program) return false;
+
+    out.source = glGetUniformLocation(out.program, "Source");
+    out.original = glGetUniformLocation(out.program, "Original");
+    out.source_size = glGetUniformLocation(out.program, "SourceSize");
+    out.original_size = glGetUniformLocation(out.program, "OriginalSize");
+    out.output_size = glGetUniformLocation(out.program, "OutputSize");
+    out.frame_count = glGetUniformLocation(out.program, "FrameCount");
+    // inactive uniforms report -1, so this only sees history the shader really reads
+    for (int k = 0; k < kMaxHistory; ++k)
+        out.prev[k] = glGetUniformLocation(out.program, ("Prev" + std::to_string(k + 1)).c_str());
+    return true;
+}
+
+void GameRenderPass::init_shader_cache(const std::string& dir, GLADloadproc load)
+{
+    cache_.init(dir, load);
+}
+
+bool GameRenderPass::init(int screen_w, int screen_h)
 {
+    screen_w_ = screen_w;
+    screen_h_ = screen_h;
+
     const char* vs_src = R"(
         #version 330 core
         layout(location=0) in vec2 pos;
         layout(location=1) in vec2 uv;
         out vec2 v_uv;
+        uniform vec2 uv_scale;
+        uniform bool flip_y;
+        uniform int rotation;
         void main() {
-            v_uv = vec2(uv.x, 1.0 - uv.y);
+            // rotate counter-clockwise in quarter turns by rotating the lookup clockwise
+            vec2 t = uv;
+            if (rotation == 1)      t = vec2(uv.y, 1.0 - uv.x);
+            else if (rotation == 2) t = vec2(1.0 - uv.x, 1.0 - uv.y);
+            else if (rotation == 3) t = vec2(1.0 - uv.y, uv.x);
+            v_uv = (flip_y ? vec2(t.x, 1.0 - t.y) : t) * uv_scale;
             gl_Position = vec4(pos,0,1);
         }
     )";
@@ -28,20 +91,42 @@ bool GameRenderPass::init(int, int)
         out vec4 color;
         uniform sampler2D tex;
         void main() {
-            color = texture(tex, v_uv);
+            color = vec4(texture(tex, v_uv).rgb, 1.0);
         }
     )";
 
-    GLuint vs = compile_shader(GL_VERTEX_SHADER, vs_src);
-    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fs_src);
-
-    shader_ = glCreateProgram();
-    glAttachShader(shader_, vs);
-    glAttachShader(shader_, fs);
-    glLinkProgram(shader_);
+    // Raw 0RGB1555 / RGB565 words, unpacked here instead of on the CPU or in the driver.
+    // format holds the retro_pixel_format value.
+    const char* decode_fs_src = R"(
+        #version 330 core
+        in vec2 v_uv;
+        out vec4 color;
+        uniform usampler2D tex;
+        uniform int format;
+        void main() {
+            ivec2 size = textureSize(tex, 0);
+            ivec2 p = min(ivec2(v_uv * vec2(size)), size - 1);
+            uint w = texelFetch(tex, p, 0).r;
+            vec3 c;
+            if (format == 2) // RGB565
+                c = vec3(float((w >> 11u) & 31u) / 31.0,
+                         float((w >> 5u) & 63u) / 63.0,
+                         float(w & 31u) / 31.0);
+            else             // 0RGB1555
+                c = vec3(float((w >> 10u) & 31u),
+                         float((w >> 5u) & 31u),
+                         float(w & 31u)) / 31.0;
+            color = vec4(c, 1.0);
+        }
+    )";
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    ShaderCache::Build builds[2] = {
+        cache_.begin("builtin", vs_src, fs_src),
+        cache_.begin("builtin-decode", vs_src, decode_fs_src),
+    };
+    shader_ = locate(cache_.finish(builds[0]));
+    decode_shader_ = locate(cache_.finish(builds[1]));
+    if (!shader_.id || !decode_shader_.id) return false;
 
     float quad[] = {
         -1,-1, 0,0,
@@ -63,14 +148,35 @@ bool GameRenderPass::init(int, int)
     glVertexAttribPointer(1,2,GL_FLOAT,false,4*sizeof(float),(void*)(2*sizeof(float)));
     glEnableVertexAttribArray(1);
 
+    glGenSamplers(2, samplers_);
+    for (int i = 0; i < 2; ++i) {
+        GLint filter = i ? GL_LINEAR : GL_NEAREST;
+        glSamplerParameteri(samplers_[i], GL_TEXTURE_MIN_FILTER, filter);
+        glSamplerParameteri(samplers_[i], GL_TEXTURE_MAG_FILTER, filter);
+        glSamplerParameteri(samplers_[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(samplers_[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    input_timer_.init();
+
     return true;
 }
 
 void GameRenderPass::shutdown()
 {
+    clear_preset();
+    pool_.shutdown();
+    input_timer_.shutdown();
+    glDeleteSamplers(2, samplers_);
     glDeleteBuffers(1, &vbo_);
     glDeleteVertexArrays(1, &vao_);
-    glDeleteProgram(shader_);
+    glDeleteProgram(shader_.id);
+    glDeleteProgram(decode_shader_.id);
+}
+
+void GameRenderPass::set_output_framebuffer(GLuint fbo)
+{
+    output_fbo_ = fbo;
 }
 
 void GameRenderPass::set_input_texture(GLuint tex)
@@ -78,11 +184,291 @@ void GameRenderPass::set_input_texture(GLuint tex)
     input_tex_ = tex;
 }
 
+void GameRenderPass::set_input_decode(bool integer, retro_pixel_format fmt)
+{
+    input_integer_ = integer;
+    input_format_ = fmt;
+}
+
+void GameRenderPass::set_input_region(float u, float v, bool flip_y)
+{
+    uv_scale_[0] = u;
+    uv_scale_[1] = v;
+    flip_y_ = flip_y;
+}
+
+void GameRenderPass::set_input_size(int w, int h)
+{
+    input_w_ = w;
+    input_h_ = h;
+}
+
+void GameRenderPass::set_input_aspect(float aspect)
+{
+    input_aspect_ = aspect;
+}
+
+void GameRenderPass::set_input_rotation(unsigned rotation)
+{
+    rotation_ = rotation & 3;
+}
+
+// Largest rectangle with the frame's (rotated) aspect centered on the screen
+GameRenderPass::Viewport GameRenderPass::output_viewport() const
+{
+    float aspect = input_aspect_;
+    if (aspect <= 0.0f && input_w_ > 0 && input_h_ > 0) aspect = (float)input_w_ / input_h_;
+    if (aspect <= 0.0f) return { 0, 0, screen_w_, screen_h_ };
+    if (rotation_ & 1) aspect = 1.0f / aspect;
+
+    int w = screen_w_;
+    int h = (int)(screen_w_ / aspect + 0.5f);
+    if (h > screen_h_) {
+        h = screen_h_;
+        w = (int)(screen_h_ * aspect + 0.5f);
+    }
+    return { (screen_w_ - w) / 2, (screen_h_ - h) / 2, w, h };
+}
+
+void GameRenderPass::set_stats(FrameStats* stats)
+{
+    stats_ = stats;
+    if (!stats_) return;
+    input_stage_ = stats_->stage("gpu.input");
+    for (size_t i = 0; i < passes_.size(); ++i)
+        passes_[i].stage = stats_->stage("gpu.pass" + std::to_string(i));
+}
+
+bool GameRenderPass::load_preset(const std::string& path)
+{
+    ShaderPreset preset;
+    if (!preset.load(path)) return false;
+
+    double t0 = FrameStats::now_ms();
+    const std::vector<ShaderPass>& descs = preset.passes();
+
+    // issue every pass before waiting on any, so they can compile in parallel
+    std::vector<ShaderCache::Build> builds;
+    for (const ShaderPass& desc : descs) builds.push_back(begin_pass(desc));
+
+    std::vector<PresetPass> passes(descs.size());
+    bool ok = true;
+    int cached = 0;
+    for (size_t i = 0; i < passes.size(); ++i) {
+        if (builds[i].cached) ++cached;
+        ok = finish_pass(descs[i], builds[i], passes[i]) && ok;
+    }
+    if (!ok) {
+        for (PresetPass& p : passes) if (p.program) glDeleteProgram(p.program);
+        return false;
+    }
+
+    std::cerr << "[shader] built " << passes.size() << " passes in " << (FrameStats::now_ms() - t0)
+        << " ms (" << cached << " from cache)\n";
+
+    // the pool is left alone so targets with matching size/format carry over
+    clear_preset();
+    passes_ = std::move(passes);
+    for (PresetPass& p : passes_) {
+        p.timer.init();
+        for (int k = 0; k < kMaxHistory; ++k)
+            if (p.prev[k] >= 0) history_depth_ = std::max(history_depth_, k + 1);
+    }
+    if (history_depth_ > 0)
+        std::cerr << "[shader] preset reads " << history_depth_ << " previous frames\n";
+    set_stats(stats_);
+    frame_count_ = 0;
+    return true;
+}
+
+void GameRenderPass::clear_preset()
+{
+    for (PresetPass& p : passes_) {
+        glDeleteProgram(p.program);
+        p.timer.shutdown();
+    }
+    passes_.clear();
+    release_history();
+}
+
+void GameRenderPass::next_frame()
+{
+    history_advance_ = true;
+}
+
+void GameRenderPass::release_history()
+{
+    for (Framebuffer& fb : history_) fb.shutdown();
+    history_.clear();
+    history_depth_ = 0;
+    history_head_ = 0;
+}
+
+// Slot the current frame is rendered into. Advancing only rotates the head
+// index; older frames stay where they are.
+Framebuffer* GameRenderPass::history_frame(int w, int h)
+{
+    size_t slots = (size_t)history_depth_ + 1;
+    if (history_.size() != slots || history_[0].width() != w || history_[0].height() != h) {
+        for (Framebuffer& fb : history_) fb.shutdown();
+        history_.assign(slots, Framebuffer());
+        for (Framebuffer& fb : history_) {
+            if (!fb.init(w, h, GL_RGBA8)) return nullptr;
+            fb.bind();
+            glClearColor(0, 0, 0, 1);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+        history_head_ = 0;
+        history_advance_ = false;
+    }
+
+    if (history_advance_) {
+        history_head_ = (history_head_ + 1) % (int)slots;
+        history_advance_ = false;
+    }
+    return &history_[history_head_];
+}
+
+void GameRenderPass::collect_timings()
+{
+    double ms = 0.0;
+    while (input_timer_.poll(ms))
+        if (stats_) stats_->add(input_stage_, ms);
+    for (PresetPass& p : passes_) {
+        while (p.timer.poll(ms))
+            if (stats_) stats_->add(p.stage, ms);
+    }
+}
+
 void GameRenderPass::render()
 {
-    glUseProgram(shader_);
+    collect_timings();
+
+    if (!passes_.empty()) {
+        render_preset();
+        return;
+    }
+
+    Viewport vp = output_viewport();
+    glBindFramebuffer(GL_FRAMEBUFFER, output_fbo_);
+    glViewport(vp.x, vp.y, vp.w, vp.h);
+    input_timer_.begin();
+    draw_input(rotation_);
+    input_timer_.end();
+    glViewport(0, 0, screen_w_, screen_h_);
+}
+
+// Draws the game texture with the built-in program into the bound target
+void GameRenderPass::draw_input(unsigned rotation)
+{
+    const Program& p = input_integer_ ? decode_shader_ : shader_;
+
+    glUseProgram(p.id);
+    glUniform1i(p.rotation, (int)rotation);
+    glUniform2f(p.uv_scale, uv_scale_[0], uv_scale_[1]);
+    glUniform1i(p.flip_y, flip_y_ ? 1 : 0);
+    if (p.format >= 0) glUniform1i(p.format, (int)input_format_);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, input_tex_);
+    glBindSampler(0, 0);
     glBindVertexArray(vao_);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
+
+void GameRenderPass::render_preset()
+{
+    pool_.begin_frame();
+
+    // Decode, crop, rotate and orient the frame into an upright texture at
+    // native resolution; every pass after this samples plain RGBA.
+    int src_w = std::max(input_w_, 1);
+    int src_h = std::max(input_h_, 1);
+    if (rotation_ & 1) std::swap(src_w, src_h);
+    Framebuffer* original = history_depth_ > 0 ?
+        history_frame(src_w, src_h) : pool_.acquire(src_w, src_h, GL_RGBA8);
+    if (!original) {
+        std::cerr << "[shader] out of framebuffers, dropping preset\n";
+        clear_preset();
+        return;
+    }
+
+    original->bind();
+    glViewport(0, 0, src_w, src_h);
+    input_timer_.begin();
+    draw_input(rotation_);
+    input_timer_.end();
+
+    Viewport vp = output_viewport();
+    Framebuffer* source = original;
+    for (size_t i = 0; i < passes_.size(); ++i) {
+        PresetPass& p = passes_[i];
+        bool last = i + 1 == passes_.size();
+
+        int out_w = vp.w, out_h = vp.h;
+        Framebuffer* target = nullptr;
+        if (!last) {
+            bool viewport = p.desc.scale_type == ShaderPass::Scale::Viewport;
+            out_w = std::max(1, (int)((viewport ? vp.w : source->width()) * p.desc.scale + 0.5f));
+            out_h = std::max(1, (int)((viewport ? vp.h : source->height()) * p.desc.scale + 0.5f));
+            target = pool_.acquire(out_w, out_h, p.desc.format);
+            if (!target) {
+                std::cerr << "[shader] out of framebuffers, dropping preset\n";
+                clear_preset();
+                break;
+            }
+            target->bind();
+        }
+        else {
+            glBindFramebuffer(GL_FRAMEBUFFER, output_fbo_);
+        }
+
+        if (target && p.desc.format == GL_SRGB8_ALPHA8) glEnable(GL_FRAMEBUFFER_SRGB);
+        else glDisable(GL_FRAMEBUFFER_SRGB);
+
+        if (last) glViewport(vp.x, vp.y, vp.w, vp.h);
+        else glViewport(0, 0, out_w, out_h);
+        glUseProgram(p.program);
+
+        GLuint sampler = samplers_[p.desc.filter_linear ? 1 : 0];
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, source->texture());
+        glBindSampler(0, sampler);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, original->texture());
+        glBindSampler(1, sampler);
+
+        int slots = (int)history_.size();
+        for (int k = 0; k < history_depth_; ++k) {
+            if (p.prev[k] < 0) continue;
+            const Framebuffer& prev = history_[(history_head_ - (k + 1) + slots) % slots];
+            glActiveTexture(GL_TEXTURE2 + k);
+            glBindTexture(GL_TEXTURE_2D, prev.texture());
+            glBindSampler(2 + k, sampler);
+            glUniform1i(p.prev[k], 2 + k);
+        }
+
+        glUniform1i(p.source, 0);
+        glUniform1i(p.original, 1);
+        glUniform4f(p.source_size, (float)source->width(), (float)source->height(),
+            1.0f / source->width(), 1.0f / source->height());
+        glUniform4f(p.original_size, (float)src_w, (float)src_h, 1.0f / src_w, 1.0f / src_h);
+        glUniform4f(p.output_size, (float)out_w, (float)out_h, 1.0f / out_w, 1.0f / out_h);
+        glUniform1i(p.frame_count, (GLint)frame_count_);
+
+        glBindVertexArray(vao_);
+        p.timer.begin();
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        p.timer.end();
+
+        if (target) source = target;
+    }
+
+    glDisable(GL_FRAMEBUFFER_SRGB);
+    for (int k = 0; k < history_depth_; ++k) glBindSampler(2 + k, 0);
+    glBindSampler(1, 0);
+    glBindSampler(0, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_FRAMEBUFFER, output_fbo_);
+    glViewport(0, 0, screen_w_, screen_h_);
+    ++frame_count_;
+}
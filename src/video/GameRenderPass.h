@@ -1,17 +1,122 @@
 #pragma once
 #include <glad/glad.h>
+#include <libretro/libretro.h>
+#include <string>
+#include <vector>
+
+#include "FramebufferPool.h"
+#include "GpuTimer.h"
+#include "ShaderCache.h"
+#include "ShaderPreset.h"
+
+class FrameStats;
 
 class GameRenderPass {
 public:
+    // optional, before init(): keep program binaries in dir; load is the GL
+    // loader used for extensions outside glad
+    void init_shader_cache(const std::string& dir, GLADloadproc load);
     bool init(int screen_w, int screen_h);
     void shutdown();
 
+    // framebuffer the final pass draws into (0 = window, or a headless target)
+    void set_output_framebuffer(GLuint fbo);
+
     void set_input_texture(GLuint tex);
+    // integer = input is a GL_R16UI texture holding raw words in the given format
+    void set_input_decode(bool integer, retro_pixel_format fmt);
+    // part of the input texture holding the frame (HW frames live in a larger FBO);
+    // flip_y for images stored top row first
+    void set_input_region(float u, float v, bool flip_y);
+    // frame size in pixels; "source" scaled preset passes are relative to it
+    void set_input_size(int w, int h);
+    // display aspect of the unrotated frame; <= 0 uses the frame's pixel ratio
+    void set_input_aspect(float aspect);
+    // counter-clockwise quarter turns (RETRO_ENVIRONMENT_SET_ROTATION)
+    void set_input_rotation(unsigned rotation);
+    // the input holds a new frame; advances the PrevN history on the next render()
+    void next_frame();
     void render();
 
+    // replaces the pass chain; the previous chain is kept if loading fails
+    bool load_preset(const std::string& path);
+    void clear_preset();
+
+    // per-pass GPU times go to stages named "gpu.<pass>"
+    void set_stats(FrameStats* stats);
+
+    static constexpr int kMaxHistory = 7; // Prev1..Prev7
+
 private:
+    struct Program {
+        GLuint id = 0;
+        GLint uv_scale = -1;
+        GLint flip_y = -1;
+        GLint format = -1;
+        GLint rotation = -1;
+    };
+
+    struct Viewport {
+        int x, y, w, h;
+    };
+
+    struct PresetPass {
+        ShaderPass desc;
+        GLuint program = 0;
+        GLint source = -1;
+        GLint original = -1;
+        GLint source_size = -1;
+        GLint original_size = -1;
+        GLint output_size = -1;
+        GLint frame_count = -1;
+        GLint prev[kMaxHistory] = { -1, -1, -1, -1, -1, -1, -1 };
+        GpuTimer timer;
+        int stage = -1;
+    };
+
+    static Program locate(GLuint program);
+    ShaderCache::Build begin_pass(const ShaderPass& desc);
+    bool finish_pass(const ShaderPass& desc, ShaderCache::Build& build, PresetPass& out);
+
+    Viewport output_viewport() const;
+    void draw_input(unsigned rotation);
+    void render_preset();
+    Framebuffer* history_frame(int w, int h);
+    void release_history();
+    void collect_timings();
+
+    ShaderCache cache_;
     GLuint vao_ = 0;
     GLuint vbo_ = 0;
-    GLuint shader_ = 0;
+    Program shader_;
+    Program decode_shader_;
     GLuint input_tex_ = 0;
+    bool input_integer_ = false;
+    retro_pixel_format input_format_ = RETRO_PIXEL_FORMAT_RGB565;
+    float uv_scale_[2] = { 1.0f, 1.0f };
+    bool flip_y_ = true;
+    int input_w_ = 0;
+    int input_h_ = 0;
+    float input_aspect_ = 0.0f;
+    unsigned rotation_ = 0;
+    int screen_w_ = 0;
+    int screen_h_ = 0;
+    GLuint output_fbo_ = 0;
+
+    // preset chain
+    std::vector<PresetPass> passes_;
+    FramebufferPool pool_;
+    GLuint samplers_[2] = {}; // nearest, linear
+    unsigned frame_count_ = 0;
+
+    // Ring of previous normalized frames for PrevN; only allocated when an
+    // active pass samples one, sized to the deepest PrevN referenced.
+    std::vector<Framebuffer> history_;
+    int history_depth_ = 0;
+    int history_head_ = 0;
+    bool history_advance_ = true;
+
+    GpuTimer input_timer_;
+    int input_stage_ = -1;
+    FrameStats* stats_ = nullptr;
 };
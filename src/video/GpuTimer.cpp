@@ -0,0 +1,48 @@
+#include "GpuTimer.h"
+
+void GpuTimer::init() {
+    glGenQueries(kLatency, queries_);
+    write_ = pending_ = 0;
+    active_ = false;
+    warm_ = false;
+}
+
+void GpuTimer::shutdown() {
+    if (queries_[0]) glDeleteQueries(kLatency, queries_);
+    for (GLuint& q : queries_) q = 0;
+}
+
+void GpuTimer::begin() {
+    if (!queries_[0] || active_) return;
+    // ring full: the oldest result is dropped rather than stalling on it
+    if (pending_ == kLatency) --pending_;
+    glBeginQuery(GL_TIME_ELAPSED, queries_[write_]);
+    active_ = true;
+}
+
+void GpuTimer::end() {
+    if (!active_) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    write_ = (write_ + 1) % kLatency;
+    ++pending_;
+    active_ = false;
+}
+
+bool GpuTimer::poll(double& ms) {
+    if (pending_ == 0) return false;
+
+    GLuint q = queries_[(write_ - pending_ + kLatency) % kLatency];
+    GLint available = 0;
+    glGetQueryObjectiv(q, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return false;
+
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(q, GL_QUERY_RESULT, &ns);
+    --pending_;
+    if (!warm_) {
+        warm_ = true;
+        return poll(ms);
+    }
+    ms = ns / 1.0e6;
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <glad/glad.h>
+
+// GL_TIME_ELAPSED measurements read back a few frames later, so taking a
+// sample never waits on the GPU. Only one timer can be inside begin()/end()
+// at a time (GL allows a single active GL_TIME_ELAPSED query).
+class GpuTimer {
+public:
+    static constexpr int kLatency = 4; // frames a result may stay in flight
+
+    void init();
+    void shutdown();
+
+    void begin();
+    void end();
+
+    // pops the oldest finished measurement; false if none is ready yet
+    bool poll(double& ms);
+
+private:
+    GLuint queries_[kLatency] = {};
+    int write_ = 0;   // next query object to begin
+    int pending_ = 0; // issued queries not read back yet
+    bool active_ = false;
+    bool warm_ = false;  // first result is dropped, llvmpipe reports garbage for it
+};
@@ -0,0 +1,81 @@
+#include "HeadlessContext.h"
+#include <iostream>
+
+#ifdef SYNCADE_HAS_EGL
+#include <EGL/eglext.h>
+
+bool HeadlessContext::init(int w, int h)
+{
+    auto get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    display_ = get_platform_display ?
+        get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) :
+        eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, nullptr, nullptr)) {
+        std::cerr << "[video] EGL init failed\n";
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "[video] EGL has no desktop OpenGL\n";
+        return false;
+    }
+
+    const EGLint attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    // EGL_KHR_no_config_context + EGL_KHR_surfaceless_context: no window, no pbuffer
+    context_ = eglCreateContext(display_, (EGLConfig)nullptr, EGL_NO_CONTEXT, attribs);
+    if (context_ == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+        std::cerr << "[video] surfaceless EGL context failed (0x" << std::hex << eglGetError() << std::dec << ")\n";
+        return false;
+    }
+
+    if (!gladLoadGLLoader(loader())) {
+        std::cerr << "GLAD init failed\n";
+        return false;
+    }
+
+    if (!target_.init(w, h)) return false;
+
+    std::cerr << "[video] headless " << w << "x" << h << " on " << glGetString(GL_RENDERER) << "\n";
+    return true;
+}
+
+void HeadlessContext::shutdown()
+{
+    target_.shutdown();
+    if (display_ != EGL_NO_DISPLAY) {
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context_ != EGL_NO_CONTEXT) eglDestroyContext(display_, context_);
+        eglTerminate(display_);
+    }
+    display_ = EGL_NO_DISPLAY;
+    context_ = EGL_NO_CONTEXT;
+}
+
+GLADloadproc HeadlessContext::loader() const
+{
+    return (GLADloadproc)eglGetProcAddress;
+}
+
+#else
+
+bool HeadlessContext::init(int, int)
+{
+    std::cerr << "[video] headless backend needs EGL, not available in this build\n";
+    return false;
+}
+
+void HeadlessContext::shutdown() {}
+
+GLADloadproc HeadlessContext::loader() const
+{
+    return nullptr;
+}
+
+#endif
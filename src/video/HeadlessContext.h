@@ -0,0 +1,39 @@
+#pragma once
+#include "GLContext.h"
+#include "Framebuffer.h"
+
+#if __has_include(<EGL/egl.h>)
+#include <EGL/egl.h>
+#define SYNCADE_HAS_EGL 1
+#endif
+
+// Surfaceless EGL context (EGL_MESA_platform_surfaceless) rendering into an
+// offscreen Framebuffer; runs the full upload and shader pipeline without a
+// display, e.g. on CI machines with Mesa llvmpipe. Presenting is a no-op.
+class HeadlessContext : public GLContext {
+public:
+    bool init(int w, int h) override;
+    void shutdown() override;
+
+    void poll_events() override {}
+    // true once frame_limit main-loop iterations ran, nothing else ever closes it
+    bool should_close() override { return frame_limit_ > 0 && frames_++ >= frame_limit_; }
+    void present() override {}
+
+    // 0 = run until killed
+    void set_frame_limit(int frames) { frame_limit_ = frames; }
+
+    GLuint target_framebuffer() const override { return target_.id(); }
+    int width() const override { return target_.width(); }
+    int height() const override { return target_.height(); }
+    GLADloadproc loader() const override;
+
+private:
+    Framebuffer target_;
+    int frame_limit_ = 0;
+    int frames_ = 0;
+#ifdef SYNCADE_HAS_EGL
+    EGLDisplay display_ = EGL_NO_DISPLAY;
+    EGLContext context_ = EGL_NO_CONTEXT;
+#endif
+};
@@ -1,36 +1,144 @@
 #include "LibretroVideo.h"
+#include <iostream>
 
-bool LibretroVideo::init(int w, int h) {
-    width = w;
-    height = h;
+struct GlUpload {
+    GLenum internal_format;
+    GLenum format;
+    GLenum type;
+    int bpp;
+};
 
+static GlUpload gl_upload(retro_pixel_format fmt, bool integer) {
+    if (integer)
+        return { GL_R16UI, GL_RED_INTEGER, GL_UNSIGNED_SHORT, 2 };
+
+    switch (fmt) {
+    case RETRO_PIXEL_FORMAT_0RGB1555:
+        return { GL_RGB5_A1, GL_BGRA, GL_UNSIGNED_SHORT_1_5_5_5_REV, 2 };
+    case RETRO_PIXEL_FORMAT_XRGB8888:
+        return { GL_RGBA8, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, 4 };
+    case RETRO_PIXEL_FORMAT_RGB565:
+    default:
+        return { GL_RGB565, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 2 };
+    }
+}
+
+bool LibretroVideo::init(int w, int h) {
     glGenTextures(1, &tex);
     glBindTexture(GL_TEXTURE_2D, tex);
 
-    glTexImage2D(
-        GL_TEXTURE_2D, 0,
-        GL_RGB565,
-        width, height,
-        0,
-        GL_RGB, GL_UNSIGNED_SHORT_5_6_5,
-        nullptr
-    );
-
+    // NEAREST is also required for integer (GL_R16UI) textures to be complete
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
+    allocate(w, h);
     return true;
 }
 
-void LibretroVideo::upload(const void* data, int pitch) {
+void LibretroVideo::shutdown() {
+    unmap();
+    if (pbo_) glDeleteBuffers(1, &pbo_);
+    pbo_ = 0;
+    if (tex) glDeleteTextures(1, &tex);
+    tex = 0;
+    width = height = 0;
+    tex_format_ = RETRO_PIXEL_FORMAT_UNKNOWN;
+}
+
+bool LibretroVideo::shader_decode() const {
+    return tex_integer_;
+}
+
+bool LibretroVideo::wants_integer() const {
+    // XRGB8888 has nothing to gain from integer decode, it always goes through the driver
+    return decode_ == PixelDecode::Shader && format_ != RETRO_PIXEL_FORMAT_XRGB8888;
+}
+
+void LibretroVideo::allocate(int w, int h) {
+    bool integer = wants_integer();
+    GlUpload up = gl_upload(format_, integer);
+
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, up.internal_format, w, h, 0, up.format, up.type, nullptr);
+
+    width = w;
+    height = h;
+    tex_format_ = format_;
+    tex_integer_ = integer;
+}
+
+void* LibretroVideo::map_frame(int w, int h, size_t& pitch) {
+    // a mapping the core never handed back (dropped frame) is released first
+    unmap();
+
+    GlUpload up = gl_upload(format_, false);
+    pitch = ((size_t)w * up.bpp + 63) & ~(size_t)63; // cache-line aligned rows
+    size_t size = pitch * h;
+
+    if (!pbo_) glGenBuffers(1, &pbo_);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+    // orphan + invalidate: the driver hands out fresh storage instead of waiting
+    // for the previous frame's texture copy to finish
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    mapped_ = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    mapped_size_ = mapped_ ? size : 0;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    return mapped_;
+}
+
+void LibretroVideo::unmap() {
+    if (!mapped_) return;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    mapped_ = nullptr;
+    mapped_size_ = 0;
+}
+
+void LibretroVideo::upload(const void* data, int w, int h, int pitch) {
+    if (w != width || h != height || format_ != tex_format_ || wants_integer() != tex_integer_)
+        allocate(w, h);
+
+    GlUpload up = gl_upload(format_, tex_integer_);
+
+    // the core drew into our mapped buffer: the texture is filled from it on the GPU
+    // side. The pointer may be past the start (a cropped frame), at the core's pitch.
+    const uint8_t* base = (const uint8_t*)mapped_;
+    const uint8_t* p = (const uint8_t*)data;
+    bool from_pbo = mapped_ && p >= base && p < base + mapped_size_;
+    if (from_pbo) {
+        size_t offset = (size_t)(p - base);
+        size_t end = offset + (size_t)(h - 1) * pitch + (size_t)w * up.bpp;
+        bool fits = end <= mapped_size_;
+        unmap();
+        if (!fits) {
+            // after the unmap the pointer is gone as well: nothing left to upload
+            std::cerr << "[video] core frame runs past the framebuffer it was given, dropped\n";
+            return;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+        data = (const void*)offset; // into the bound unpack buffer
+    }
+    else {
+        unmap();
+    }
+
     glBindTexture(GL_TEXTURE_2D, tex);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / 2);
+    // pitch is in bytes and not necessarily a multiple of 4
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / up.bpp);
     glTexSubImage2D(
         GL_TEXTURE_2D, 0,
         0, 0, width, height,
-        GL_RGB, GL_UNSIGNED_SHORT_5_6_5,
+        up.format, up.type,
         data
     );
 
     glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (from_pbo) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 }
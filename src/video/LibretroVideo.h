@@ -1,15 +1,54 @@
 #pragma once
 #include <glad/glad.h>
+#include <cstddef>
 #include <cstdint>
+#include <libretro/libretro.h>
+
+// Where the core's pixel format is turned into RGB
+enum class PixelDecode {
+    Driver, // glTexSubImage2D with a packed GL type; the driver converts on upload
+    Shader, // 16-bit words uploaded as GL_R16UI and unpacked by GameRenderPass
+};
 
 class LibretroVideo {
 public:
     bool init(int w, int h);
-    void upload(const void* data, int pitch);
+    void shutdown();
+
+    void set_format(retro_pixel_format fmt) { format_ = fmt; }
+    void set_decode(PixelDecode decode) { decode_ = decode; }
+
+    // uploads one core frame, reallocating the texture only when size/format change
+    void upload(const void* data, int w, int h, int pitch);
+
+    // GET_CURRENT_SOFTWARE_FRAMEBUFFER: maps a pixel unpack buffer for the core to
+    // draw into (current format, write-only, contents undefined). When the core
+    // hands back a pointer into it (the start, or a cropped offset), upload() sources
+    // the texture from the buffer instead of client memory. nullptr if the buffer
+    // could not be mapped.
+    void* map_frame(int w, int h, size_t& pitch);
+
     GLuint texture() const { return tex; }
+    retro_pixel_format format() const { return format_; }
+
+    // true when the current texture holds raw words that the shader must decode
+    bool shader_decode() const;
 
 private:
+    void allocate(int w, int h);
+    bool wants_integer() const;
+    void unmap();
+
     GLuint tex = 0;
     int width = 0;
     int height = 0;
+
+    retro_pixel_format format_ = RETRO_PIXEL_FORMAT_0RGB1555; // libretro default without SET_PIXEL_FORMAT
+    PixelDecode decode_ = PixelDecode::Driver;
+    retro_pixel_format tex_format_ = RETRO_PIXEL_FORMAT_UNKNOWN;
+    bool tex_integer_ = false;
+
+    GLuint pbo_ = 0;
+    void* mapped_ = nullptr; // live mapping handed to the core, until the next upload
+    size_t mapped_size_ = 0;
 };
@@ -0,0 +1,193 @@
+#include "ShaderCache.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// KHR_parallel_shader_compile is not part of the generated loader
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+static const char kBinaryMagic[8] = { 'S', 'Y', 'N', 'C', 'B', 'I', 'N', '1' };
+
+static uint64_t fnv1a(const std::string& s, uint64_t h = 1469598103934665603ull) {
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static bool has_extension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (ext && std::strcmp(ext, name) == 0) return true;
+    }
+    return false;
+}
+
+static GLuint compile_shader(GLenum type, const std::string& src)
+{
+    const char* p = src.c_str();
+    GLuint s = glCreateShader(type);
+    glShaderSource(s, 1, &p, nullptr);
+    glCompileShader(s);
+    return s;
+}
+
+static bool check_shader(GLuint s, const std::string& name, const char* stage)
+{
+    GLint ok = GL_FALSE;
+    glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+    if (ok) return true;
+
+    char log[1024] = {};
+    glGetShaderInfoLog(s, sizeof(log), nullptr, log);
+    std::cerr << "[shader] " << name << ": " << stage << " compile failed\n" << log << "\n";
+    return false;
+}
+
+void ShaderCache::init(const std::string& dir, GLADloadproc load) {
+    dir_ = dir;
+    driver_ = std::string((const char*)glGetString(GL_RENDERER)) + "|" +
+        (const char*)glGetString(GL_VERSION);
+
+    GLint formats = 0;
+    if (glProgramBinary && glGetProgramBinary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    binaries_ = !dir_.empty() && formats > 0;
+    if (binaries_) {
+        std::error_code ec;
+        std::filesystem::create_directories(dir_, ec);
+    }
+
+    parallel_ = false;
+    if (load && has_extension("GL_KHR_parallel_shader_compile")) {
+        auto max_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+        if (max_threads) {
+            max_threads(0xFFFFFFFFu); // implementation-chosen thread count
+            parallel_ = true;
+        }
+    }
+
+    std::cerr << "[shader] program binaries " << (binaries_ ? "on" : "off")
+        << ", parallel compile " << (parallel_ ? "on" : "off") << "\n";
+}
+
+ShaderCache::Build ShaderCache::begin(const std::string& name, const std::string& vs_src, const std::string& fs_src) {
+    Build b;
+    b.name = name;
+    b.key = fnv1a(fs_src, fnv1a(std::string(1, '\0'), fnv1a(vs_src, fnv1a(driver_))));
+    b.program = glCreateProgram();
+
+    if (binaries_ && load_binary(b.key, b.program)) {
+        b.cached = true;
+        return b;
+    }
+
+    // no status queries here: that would serialize the batch
+    b.vs = compile_shader(GL_VERTEX_SHADER, vs_src);
+    b.fs = compile_shader(GL_FRAGMENT_SHADER, fs_src);
+    glAttachShader(b.program, b.vs);
+    glAttachShader(b.program, b.fs);
+    if (binaries_) glProgramParameteri(b.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(b.program);
+    return b;
+}
+
+GLuint ShaderCache::finish(Build& b) {
+    if (b.cached) return b.program;
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(b.program, GL_LINK_STATUS, &linked);
+
+    bool ok = linked == GL_TRUE;
+    if (!ok) {
+        // the per-stage logs usually say more than the link log
+        bool vs_ok = check_shader(b.vs, b.name, "vertex");
+        bool fs_ok = check_shader(b.fs, b.name, "fragment");
+        if (vs_ok && fs_ok) {
+            char log[1024] = {};
+            glGetProgramInfoLog(b.program, sizeof(log), nullptr, log);
+            std::cerr << "[shader] " << b.name << ": link failed\n" << log << "\n";
+        }
+    }
+
+    glDetachShader(b.program, b.vs);
+    glDetachShader(b.program, b.fs);
+    glDeleteShader(b.vs);
+    glDeleteShader(b.fs);
+    b.vs = b.fs = 0;
+
+    if (!ok) {
+        glDeleteProgram(b.program);
+        b.program = 0;
+        return 0;
+    }
+
+    if (binaries_) store_binary(b.key, b.program);
+    return b.program;
+}
+
+std::string ShaderCache::path_for(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return dir_ + "/" + name;
+}
+
+bool ShaderCache::load_binary(uint64_t key, GLuint program) const {
+    std::ifstream f(path_for(key), std::ios::binary);
+    if (!f) return false;
+
+    char magic[8];
+    GLenum format = 0;
+    uint32_t size = 0;
+    f.read(magic, sizeof(magic));
+    f.read((char*)&format, sizeof(format));
+    f.read((char*)&size, sizeof(size));
+    if (!f || std::memcmp(magic, kBinaryMagic, sizeof(magic)) != 0 || size == 0) return false;
+
+    std::vector<char> data(size);
+    f.read(data.data(), size);
+    if (!f) return false;
+
+    glProgramBinary(program, format, data.data(), (GLsizei)size);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // stale (driver update) or corrupt; rebuild from source
+        std::error_code ec;
+        std::filesystem::remove(path_for(key), ec);
+        return false;
+    }
+    return true;
+}
+
+void ShaderCache::store_binary(uint64_t key, GLuint program) const {
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) return;
+
+    std::vector<char> data(size);
+    GLenum format = 0;
+    glGetProgramBinary(program, size, nullptr, &format, data.data());
+
+    // write aside and rename so a crash never leaves a truncated binary behind
+    std::string path = path_for(key);
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f) return;
+        uint32_t size32 = (uint32_t)size;
+        f.write(kBinaryMagic, sizeof(kBinaryMagic));
+        f.write((const char*)&format, sizeof(format));
+        f.write((const char*)&size32, sizeof(size32));
+        f.write(data.data(), size);
+        if (!f) return;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+// Compiles and links GL programs, checking and logging every stage, and keeps
+// linked binaries on disk (glGetProgramBinary/glProgramBinary) keyed by a hash
+// of the sources plus GL_RENDERER/GL_VERSION. A binary the driver rejects is
+// dropped and the program is rebuilt from source.
+//
+// begin()/finish() are split so a batch of programs can be issued before any
+// status is queried; with KHR_parallel_shader_compile the driver then builds
+// them on its own threads.
+class ShaderCache {
+public:
+    struct Build {
+        std::string name;
+        GLuint program = 0;
+        GLuint vs = 0;
+        GLuint fs = 0;
+        uint64_t key = 0;
+        bool cached = false;
+    };
+
+    // dir empty = no disk cache; load resolves KHR_parallel_shader_compile
+    void init(const std::string& dir, GLADloadproc load);
+
+    Build begin(const std::string& name, const std::string& vs_src, const std::string& fs_src);
+    // waits for the link and stores the binary; returns 0 on failure
+    GLuint finish(Build& build);
+
+    GLuint build(const std::string& name, const std::string& vs_src, const std::string& fs_src) {
+        Build b = begin(name, vs_src, fs_src);
+        return finish(b);
+    }
+
+    bool parallel() const { return parallel_; }
+
+private:
+    std::string path_for(uint64_t key) const;
+    bool load_binary(uint64_t key, GLuint program) const;
+    void store_binary(uint64_t key, GLuint program) const;
+
+    std::string dir_;
+    std::string driver_;
+    bool binaries_ = false;
+    bool parallel_ = false;
+};
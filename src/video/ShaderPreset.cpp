@@ -0,0 +1,89 @@
+#include "ShaderPreset.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+static std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r\n\"");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r\n\"");
+    return s.substr(b, e - b + 1);
+}
+
+static bool read_file(const std::string& path, std::string& out) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    std::stringstream ss;
+    ss << f.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+bool ShaderPreset::load(const std::string& path) {
+    std::ifstream f(path);
+    if (!f) {
+        std::cerr << "[shader] cannot open preset " << path << "\n";
+        return false;
+    }
+
+    std::map<std::string, std::string> kv;
+    std::string line;
+    while (std::getline(f, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        kv[trim(line.substr(0, eq))] = trim(line.substr(eq + 1));
+    }
+
+    auto it = kv.find("shaders");
+    int count = (it != kv.end()) ? std::atoi(it->second.c_str()) : 0;
+    if (count <= 0) {
+        std::cerr << "[shader] preset " << path << " has no passes\n";
+        return false;
+    }
+
+    std::string dir;
+    size_t slash = path.find_last_of("/\\");
+    if (slash != std::string::npos) dir = path.substr(0, slash + 1);
+
+    auto get = [&](const std::string& key, int i) -> const std::string* {
+        auto found = kv.find(key + std::to_string(i));
+        return (found != kv.end()) ? &found->second : nullptr;
+    };
+
+    std::vector<ShaderPass> passes;
+    for (int i = 0; i < count; ++i) {
+        ShaderPass pass;
+        const std::string* shader = get("shader", i);
+        if (!shader) {
+            std::cerr << "[shader] preset " << path << ": missing shader" << i << "\n";
+            return false;
+        }
+        pass.path = dir + *shader;
+        if (!read_file(pass.path, pass.source)) {
+            std::cerr << "[shader] cannot read " << pass.path << "\n";
+            return false;
+        }
+
+        if (const std::string* v = get("scale_type", i))
+            pass.scale_type = (*v == "viewport") ? ShaderPass::Scale::Viewport : ShaderPass::Scale::Source;
+        if (const std::string* v = get("scale", i))
+            pass.scale = (float)std::atof(v->c_str());
+        if (const std::string* v = get("filter_linear", i))
+            pass.filter_linear = (*v == "true" || *v == "1");
+        if (const std::string* v = get("float_framebuffer", i))
+            if (*v == "true" || *v == "1") pass.format = GL_RGBA16F;
+        if (const std::string* v = get("srgb_framebuffer", i))
+            if (*v == "true" || *v == "1") pass.format = GL_SRGB8_ALPHA8;
+
+        passes.push_back(std::move(pass));
+    }
+
+    path_ = path;
+    passes_ = std::move(passes);
+    std::cerr << "[shader] loaded preset " << path << " (" << passes_.size() << " passes)\n";
+    return true;
+}
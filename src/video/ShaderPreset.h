@@ -0,0 +1,44 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+// One pass of a shader preset. The GLSL file holds both stages guarded by
+// "#if defined(VERTEX)" / "#elif defined(FRAGMENT)" (no #version line, it is
+// prepended together with the stage define). Files without a VERTEX section are
+// treated as fragment-only and get a pass-through vertex stage.
+//
+// Inputs: pos (location 0), uv (location 1), sampler2D Source and Original,
+// vec4 SourceSize / OriginalSize / OutputSize (w, h, 1/w, 1/h), int FrameCount,
+// and sampler2D Prev1..Prev7 for the previous frames (Original is the current one).
+struct ShaderPass {
+    enum class Scale { Source, Viewport };
+
+    std::string path;
+    std::string source;
+    Scale scale_type = Scale::Source;
+    float scale = 1.0f;
+    bool filter_linear = false;  // how this pass samples its input
+    GLenum format = GL_RGBA8;    // GL_RGBA16F / GL_SRGB8_ALPHA8 via float_/srgb_framebuffer
+};
+
+// Loads a .glslp-style preset:
+//   shaders = 2
+//   shader0 = crt/scanlines.glsl      (relative to the preset file)
+//   scale_type0 = source | viewport
+//   scale0 = 2.0
+//   filter_linear0 = true
+//   float_framebuffer0 = false
+//   srgb_framebuffer0 = false
+// The last pass always renders to the screen at output resolution.
+class ShaderPreset {
+public:
+    bool load(const std::string& path);
+
+    const std::vector<ShaderPass>& passes() const { return passes_; }
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    std::vector<ShaderPass> passes_;
+};
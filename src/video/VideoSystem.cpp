@@ -1,37 +1,219 @@
 #include "VideoSystem.h"
+#include <cstring>
 #include <iostream>
 
-bool VideoSystem::init() {
-    window = SDL_CreateWindow("Arcade Engine",
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SYNCADE_SSE2 1
+#endif
+
+static Uint32 sdl_format(retro_pixel_format fmt) {
+    switch (fmt) {
+    case RETRO_PIXEL_FORMAT_0RGB1555: return SDL_PIXELFORMAT_RGB555;
+    case RETRO_PIXEL_FORMAT_XRGB8888: return SDL_PIXELFORMAT_RGB888;
+    case RETRO_PIXEL_FORMAT_RGB565:
+    default:                          return SDL_PIXELFORMAT_RGB565;
+    }
+}
+
+// --- Integer nearest-neighbour row widening ---
+template <typename T>
+static void widen_row_scalar(const T* src, T* dst, unsigned w, int factor) {
+    for (unsigned x = 0; x < w; ++x)
+        for (int i = 0; i < factor; ++i) *dst++ = src[x];
+}
+
+static void widen_row16(const uint16_t* src, uint16_t* dst, unsigned w, int factor) {
+#ifdef SYNCADE_SSE2
+    if (factor == 2 || factor == 4) {
+        unsigned x = 0;
+        for (; x + 8 <= w; x += 8) {
+            __m128i p = _mm_loadu_si128((const __m128i*)(src + x));
+            __m128i lo = _mm_unpacklo_epi16(p, p); // p0 p0 p1 p1 p2 p2 p3 p3
+            __m128i hi = _mm_unpackhi_epi16(p, p);
+            if (factor == 2) {
+                _mm_storeu_si128((__m128i*)dst, lo);
+                _mm_storeu_si128((__m128i*)(dst + 8), hi);
+                dst += 16;
+            } else {
+                _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi32(lo, lo));
+                _mm_storeu_si128((__m128i*)(dst + 8), _mm_unpackhi_epi32(lo, lo));
+                _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpacklo_epi32(hi, hi));
+                _mm_storeu_si128((__m128i*)(dst + 24), _mm_unpackhi_epi32(hi, hi));
+                dst += 32;
+            }
+        }
+        widen_row_scalar(src + x, dst, w - x, factor);
+        return;
+    }
+#endif
+    widen_row_scalar(src, dst, w, factor);
+}
+
+static void widen_row32(const uint32_t* src, uint32_t* dst, unsigned w, int factor) {
+#ifdef SYNCADE_SSE2
+    if (factor == 2 || factor == 4) {
+        unsigned x = 0;
+        for (; x + 4 <= w; x += 4) {
+            __m128i p = _mm_loadu_si128((const __m128i*)(src + x));
+            __m128i lo = _mm_unpacklo_epi32(p, p); // p0 p0 p1 p1
+            __m128i hi = _mm_unpackhi_epi32(p, p);
+            if (factor == 2) {
+                _mm_storeu_si128((__m128i*)dst, lo);
+                _mm_storeu_si128((__m128i*)(dst + 4), hi);
+                dst += 8;
+            } else {
+                _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi64(lo, lo));
+                _mm_storeu_si128((__m128i*)(dst + 4), _mm_unpackhi_epi64(lo, lo));
+                _mm_storeu_si128((__m128i*)(dst + 8), _mm_unpacklo_epi64(hi, hi));
+                _mm_storeu_si128((__m128i*)(dst + 12), _mm_unpackhi_epi64(hi, hi));
+                dst += 16;
+            }
+        }
+        widen_row_scalar(src + x, dst, w - x, factor);
+        return;
+    }
+#endif
+    widen_row_scalar(src, dst, w, factor);
+}
+
+// --- VideoSystem ---
+bool VideoSystem::init(int w, int h) {
+    if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) {
+        std::cerr << "[video] SDL video init failed: " << SDL_GetError() << "\n";
+        return false;
+    }
+
+    window = SDL_CreateWindow("Syncade",
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        1280, 720, SDL_WINDOW_SHOWN);
+        w, h, SDL_WINDOW_SHOWN);
+    if (!window) return false;
+
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    if (!renderer) renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+    if (!renderer) return false;
 
-    renderer = SDL_CreateRenderer(window, -1,
-        SDL_RENDERER_ACCELERATED);
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0)
+        std::cerr << "[video] SDL renderer: " << info.name << "\n";
+    return true;
+}
+
+bool VideoSystem::allocate(unsigned w, unsigned h) {
+    if (texture) SDL_DestroyTexture(texture);
+
+    // the prescale keeps pixels sharp, linear filtering only smooths the last fraction
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, prescale_ > 1 ? "linear" : "nearest");
+    texture = SDL_CreateTexture(renderer, sdl_format(format_),
+        SDL_TEXTUREACCESS_STREAMING, w * prescale_, h * prescale_);
+    if (!texture) {
+        std::cerr << "[video] SDL_CreateTexture failed: " << SDL_GetError() << "\n";
+        width = height = 0;
+        return false;
+    }
 
-    return window && renderer;
+    width = w; height = h;
+    tex_format_ = format_;
+    tex_prescale_ = prescale_;
+    return true;
 }
 
-void VideoSystem::render(const void* data, unsigned w, unsigned h, size_t pitch) {
-    if (!data) return;
+void VideoSystem::upload(const void* data, unsigned w, unsigned h, size_t pitch) {
+    if (!data || !renderer) return;
 
-    if (!texture || w != width || h != height) {
-        if (texture) SDL_DestroyTexture(texture);
-        width = w; height = h;
-        texture = SDL_CreateTexture(renderer,
-            SDL_PIXELFORMAT_RGB565,
-            SDL_TEXTUREACCESS_STREAMING,
-            w, h);
+    if (!texture || w != width || h != height || format_ != tex_format_ || prescale_ != tex_prescale_) {
+        if (!allocate(w, h)) return;
     }
 
-    SDL_UpdateTexture(texture, nullptr, data, pitch);
+    void* pixels = nullptr;
+    int tex_pitch = 0;
+    if (SDL_LockTexture(texture, nullptr, &pixels, &tex_pitch) != 0) return;
+
+    // rows are written straight into the texture memory, no staging copy
+    const int f = tex_prescale_;
+    const size_t bpp = (tex_format_ == RETRO_PIXEL_FORMAT_XRGB8888) ? 4 : 2;
+    const size_t row_bytes = (size_t)w * f * bpp;
+    const uint8_t* src = (const uint8_t*)data;
+    uint8_t* dst = (uint8_t*)pixels;
+
+    for (unsigned y = 0; y < h; ++y, src += pitch) {
+        uint8_t* row = dst;
+        if (f == 1)
+            std::memcpy(row, src, row_bytes);
+        else if (bpp == 2)
+            widen_row16((const uint16_t*)src, (uint16_t*)row, w, f);
+        else
+            widen_row32((const uint32_t*)src, (uint32_t*)row, w, f);
+        dst += tex_pitch;
+
+        for (int i = 1; i < f; ++i, dst += tex_pitch)
+            std::memcpy(dst, row, row_bytes);
+    }
+
+    SDL_UnlockTexture(texture);
+}
+
+void VideoSystem::present() {
+    if (!renderer) return;
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     SDL_RenderClear(renderer);
-    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+
+    if (texture && width && height) {
+        int ow = 0, oh = 0;
+        SDL_GetRendererOutputSize(renderer, &ow, &oh);
+
+        // fit the displayed (rotated) aspect into the output, letterboxed
+        float aspect = aspect_ > 0.0f ? aspect_ : (float)width / height;
+        bool quarter = (rotation_ & 1) != 0;
+        if (quarter) aspect = 1.0f / aspect;
+
+        int dw = ow, dh = (int)(ow / aspect + 0.5f);
+        if (dh > oh) {
+            dh = oh;
+            dw = (int)(oh * aspect + 0.5f);
+        }
+
+        // SDL rotates the rect around its centre, so it is given unrotated
+        SDL_Rect dst;
+        dst.w = quarter ? dh : dw;
+        dst.h = quarter ? dw : dh;
+        dst.x = (ow - dst.w) / 2;
+        dst.y = (oh - dst.h) / 2;
+
+        // libretro turns counter-clockwise, SDL clockwise
+        double angle = rotation_ ? 360.0 - 90.0 * rotation_ : 0.0;
+        SDL_RenderCopyEx(renderer, texture, nullptr, &dst, angle, nullptr, SDL_FLIP_NONE);
+    }
+
     SDL_RenderPresent(renderer);
 }
 
+bool VideoSystem::poll_events() {
+    bool open = true;
+    SDL_Event e;
+    while (SDL_PollEvent(&e)) {
+        if (e.type == SDL_QUIT) open = false;
+        if (e.type == SDL_WINDOWEVENT &&
+            (e.window.event == SDL_WINDOWEVENT_EXPOSED || e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED))
+            damaged_ = true;
+    }
+    return open;
+}
+
+bool VideoSystem::take_damage() {
+    bool d = damaged_;
+    damaged_ = false;
+    return d;
+}
+
 void VideoSystem::shutdown() {
     if (texture) SDL_DestroyTexture(texture);
     if (renderer) SDL_DestroyRenderer(renderer);
     if (window) SDL_DestroyWindow(window);
+    texture = nullptr;
+    renderer = nullptr;
+    window = nullptr;
+    width = height = 0;
+    tex_format_ = RETRO_PIXEL_FORMAT_UNKNOWN;
 }
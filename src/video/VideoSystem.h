@@ -1,15 +1,47 @@
 #pragma once
 #include <SDL2/SDL.h>
+#include <cstdint>
+#include <libretro/libretro.h>
 
+// CPU presentation backend for machines with poor GL drivers: the core frame is
+// written straight into a locked SDL streaming texture (optionally widened by an
+// integer nearest-neighbour prescale) and drawn with SDL_Renderer.
 class VideoSystem {
 public:
-    bool init();
-    void render(const void* data, unsigned w, unsigned h, size_t pitch);
+    bool init(int w, int h);
     void shutdown();
 
+    void set_format(retro_pixel_format fmt) { format_ = fmt; }
+    // 1 = off; >1 prescales by an integer factor and lets the renderer filter the rest
+    void set_prescale(int factor) { prescale_ = factor < 1 ? 1 : factor; }
+    // display aspect of the unrotated frame, 0 = pixel ratio
+    void set_aspect(float aspect) { aspect_ = aspect; }
+    // RETRO_ENVIRONMENT_SET_ROTATION, counter-clockwise quarter turns
+    void set_rotation(unsigned rotation) { rotation_ = rotation & 3; }
+
+    // copies one core frame into the streaming texture
+    void upload(const void* data, unsigned w, unsigned h, size_t pitch);
+    // draws the last uploaded frame and presents
+    void present();
+
+    // pumps SDL events; false once the window was closed
+    bool poll_events();
+    // true once after the window was exposed or resized; clears the flag
+    bool take_damage();
+
 private:
+    bool allocate(unsigned w, unsigned h);
+
     SDL_Window* window = nullptr;
     SDL_Renderer* renderer = nullptr;
     SDL_Texture* texture = nullptr;
-    unsigned width = 0, height = 0;
+    unsigned width = 0, height = 0; // core frame size the texture was made for
+
+    retro_pixel_format format_ = RETRO_PIXEL_FORMAT_0RGB1555; // libretro default without SET_PIXEL_FORMAT
+    retro_pixel_format tex_format_ = RETRO_PIXEL_FORMAT_UNKNOWN;
+    int prescale_ = 1;
+    int tex_prescale_ = 0;
+    float aspect_ = 0.0f;
+    unsigned rotation_ = 0;
+    bool damaged_ = true;
 };
@@ -0,0 +1,81 @@
+#include "WindowContext.h"
+#include <iostream>
+
+bool WindowContext::init(int w, int h)
+{
+    if (!glfwInit()) {
+        std::cerr << "GLFW init failed\n";
+        return false;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    window_ = glfwCreateWindow(w, h, "Syncade", nullptr, nullptr);
+    if (!window_) {
+        glfwTerminate();
+        return false;
+    }
+
+    glfwMakeContextCurrent(window_);
+
+    // present-on-demand still has to repaint when the compositor asks for it
+    glfwSetWindowUserPointer(window_, this);
+    glfwSetWindowRefreshCallback(window_, [](GLFWwindow* w) {
+        static_cast<WindowContext*>(glfwGetWindowUserPointer(w))->damaged_ = true;
+    });
+    glfwSetFramebufferSizeCallback(window_, [](GLFWwindow* w, int, int) {
+        static_cast<WindowContext*>(glfwGetWindowUserPointer(w))->damaged_ = true;
+    });
+    // a tap between two polls (or during glfwWaitEvents) is still seen by glfwGetKey
+    glfwSetInputMode(window_, GLFW_STICKY_KEYS, GLFW_TRUE);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cerr << "GLAD init failed\n";
+        return false;
+    }
+
+    width_ = w;
+    height_ = h;
+    return true;
+}
+
+bool WindowContext::take_damage()
+{
+    bool d = damaged_;
+    damaged_ = false;
+    return d;
+}
+
+double WindowContext::refresh_rate() const
+{
+    if (!window_) return 0.0;
+    // fullscreen: its monitor; windowed: the monitor under the window's centre
+    GLFWmonitor* monitor = glfwGetWindowMonitor(window_);
+    if (!monitor) {
+        int x, y, w, h;
+        glfwGetWindowPos(window_, &x, &y);
+        glfwGetWindowSize(window_, &w, &h);
+        int cx = x + w / 2, cy = y + h / 2;
+        int count = 0;
+        GLFWmonitor** monitors = glfwGetMonitors(&count);
+        for (int i = 0; i < count && !monitor; ++i) {
+            const GLFWvidmode* mode = glfwGetVideoMode(monitors[i]);
+            int mx, my;
+            glfwGetMonitorPos(monitors[i], &mx, &my);
+            if (mode && cx >= mx && cx < mx + mode->width && cy >= my && cy < my + mode->height)
+                monitor = monitors[i];
+        }
+    }
+    if (!monitor) monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+    return mode ? mode->refreshRate : 0.0;
+}
+
+void WindowContext::shutdown()
+{
+    if (window_) glfwDestroyWindow(window_);
+    window_ = nullptr;
+    glfwTerminate();
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "GLContext.h"
+#include <GLFW/glfw3.h>
+
+class WindowContext : public GLContext {
+public:
+    bool init(int w, int h) override;
+    void shutdown() override;
+
+    void poll_events() override { glfwPollEvents(); }
+    void wait_events() override { glfwWaitEvents(); }
+    bool take_damage() override;
+    bool should_close() override { return glfwWindowShouldClose(window_) != 0; }
+    void present() override { glfwSwapBuffers(window_); }
+    void set_swap_interval(int interval) override { glfwSwapInterval(interval); }
+    double refresh_rate() const override;
+
+    GLuint target_framebuffer() const override { return 0; }
+    int width() const override { return width_; }
+    int height() const override { return height_; }
+    GLADloadproc loader() const override { return (GLADloadproc)glfwGetProcAddress; }
+    GLFWwindow* window() const override { return window_; }
+
+private:
+    GLFWwindow* window_ = nullptr;
+    bool damaged_ = true; // first frame always draws
+    int width_ = 0;
+    int height_ = 0;
+};